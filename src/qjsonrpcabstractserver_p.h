@@ -18,8 +18,8 @@
 #define QJSONRPCABSTRACTSERVER_P_H
 
 #include "qjsonrpcabstractserver.h"
+#include "qjsonrpcsocket.h"
 
-class QJsonRpcSocket;
 #if defined(USE_QT_PRIVATE_HEADERS)
 #include <private/qobject_p.h>
 
@@ -29,6 +29,11 @@ class QJsonRpcAbstractServerPrivate
 #endif
 {
 public:
+    QJsonRpcAbstractServerPrivate()
+        : wireFormat(QJsonRpcSocket::JsonWireFormat),
+          compressionThreshold(-1)
+    {}
+
 #if !defined(USE_QT_PRIVATE_HEADERS)
     virtual ~QJsonRpcAbstractServerPrivate() {}
 #endif
@@ -37,6 +42,9 @@ public:
     void _q_notifyConnectedClients(const QString &method, const QJsonArray &params);
 
     QList<QJsonRpcSocket*> clients;
+    QJsonRpcSocket::WireFormat wireFormat;
+    int compressionThreshold;
+    QByteArray compressionDictionary;
 };
 
 #endif
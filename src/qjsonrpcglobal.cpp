@@ -15,6 +15,7 @@
  * Lesser General Public License for more details.
  */
 
+#include "qjsonrpcobjectpool_p.h"
 #include "qjsonrpcglobal.h"
 
 namespace QJsonRpc {
@@ -22,3 +23,9 @@ namespace QJsonRpc {
 bool debugEnabled = qEnvironmentVariableIsSet("QJSONRPC_DEBUG");
 
 }
+
+QJsonRpcObjectPoolStatistics &qJsonRpcObjectPoolStatistics()
+{
+    static thread_local QJsonRpcObjectPoolStatistics statistics = { 0, 0 };
+    return statistics;
+}
@@ -31,6 +31,7 @@ namespace QJsonRpc {
         InvalidParams   = -32602,           // Invalid method parameter(s).
         InternalError   = -32603,           // Internal JSON-RPC error.
         ServerErrorBase = -32000,           // Reserved for implementation-defined server-errors.
+        ServerBusy      = -32001,           // The queue of a concurrency limit is full.
         UserError       = -32099,           // Anything after this is user defined
         TimeoutError    = -32100
     };
@@ -150,7 +150,7 @@ public:
             request.setSslConfiguration(sslConfiguration);
 #endif
 
-        QByteArray data = message.toJson();
+        QByteArray data = message.inlineAttachments().toJson(QJsonDocument::Compact);
         qJsonRpcDebug() << "sending: " << data;
         return networkAccessManager->post(request, data);
     }
@@ -293,20 +293,10 @@ QJsonRpcMessage QJsonRpcHttpClient::invokeRemoteMethodBlocking(const QString &me
                                                                const QVariant &param8, const QVariant &param9,
                                                                const QVariant &param10)
 {
-    QVariantList params;
-    if (param1.isValid()) params.append(param1);
-    if (param2.isValid()) params.append(param2);
-    if (param3.isValid()) params.append(param3);
-    if (param4.isValid()) params.append(param4);
-    if (param5.isValid()) params.append(param5);
-    if (param6.isValid()) params.append(param6);
-    if (param7.isValid()) params.append(param7);
-    if (param8.isValid()) params.append(param8);
-    if (param9.isValid()) params.append(param9);
-    if (param10.isValid()) params.append(param10);
-
-    QJsonRpcMessage request =
-        QJsonRpcMessage::createRequest(method, QJsonArray::fromVariantList(params));
+    const QJsonArray params = QJsonRpcAbstractSocketPrivate::paramsFromVariants({
+        &param1, &param2, &param3, &param4, &param5, &param6, &param7, &param8, &param9, &param10 });
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest(method, params);
     return sendMessageBlocking(request, msecs);
 }
 
@@ -329,20 +319,10 @@ QJsonRpcServiceReply *QJsonRpcHttpClient::invokeRemoteMethod(const QString &meth
                                                              const QVariant &param8, const QVariant &param9,
                                                              const QVariant &param10)
 {
-    QVariantList params;
-    if (param1.isValid()) params.append(param1);
-    if (param2.isValid()) params.append(param2);
-    if (param3.isValid()) params.append(param3);
-    if (param4.isValid()) params.append(param4);
-    if (param5.isValid()) params.append(param5);
-    if (param6.isValid()) params.append(param6);
-    if (param7.isValid()) params.append(param7);
-    if (param8.isValid()) params.append(param8);
-    if (param9.isValid()) params.append(param9);
-    if (param10.isValid()) params.append(param10);
-
-    QJsonRpcMessage request =
-        QJsonRpcMessage::createRequest(method, QJsonArray::fromVariantList(params));
+    const QJsonArray params = QJsonRpcAbstractSocketPrivate::paramsFromVariants({
+        &param1, &param2, &param3, &param4, &param5, &param6, &param7, &param8, &param9, &param10 });
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest(method, params);
     return sendMessage(request);
 }
 
@@ -191,7 +191,16 @@ int QJsonRpcHttpServerSocket::onMessageComplete(http_parser *parser)
 {
     QJsonRpcHttpServerSocket *request = (QJsonRpcHttpServerSocket *)parser->data;
     qJsonRpcDebug() << Q_FUNC_INFO << request->m_requestPayload;
-    QJsonRpcMessage message = QJsonRpcMessage::fromJson(request->m_requestPayload);
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(request->m_requestPayload, &error);
+    if (error.error != QJsonParseError::NoError) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "parse error:" << error.errorString();
+        QJsonRpcMessage response = QJsonRpcMessage().createStandardErrorResponse(QJsonRpc::ParseError);
+        request->write(response.toJson(QJsonDocument::Compact));
+        return 0;
+    }
+
+    QJsonRpcMessage message = QJsonRpcMessage::fromObject(document.object());
     Q_EMIT request->messageReceived(message);
     return 0;
 }
@@ -3,6 +3,7 @@
 
 #include "qjsonrpcsocket.h"
 #include "qjsonrpcabstractserver_p.h"
+#include "qjsonrpcwireformat_p.h"
 #include "qjsonrpclocalserver.h"
 
 class QJsonRpcLocalServerPrivate : public QJsonRpcAbstractServerPrivate
@@ -42,6 +43,52 @@ int QJsonRpcLocalServer::connectedClientCount() const
     return d->clients.size();
 }
 
+void QJsonRpcLocalServer::setWireFormat(QJsonRpcSocket::WireFormat format)
+{
+    Q_D(QJsonRpcLocalServer);
+    if (!QJsonRpcWireFormat::isSupported(format)) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "unsupported wire format" << format;
+        return;
+    }
+
+    d->wireFormat = format;
+}
+
+QJsonRpcSocket::WireFormat QJsonRpcLocalServer::wireFormat() const
+{
+    Q_D(const QJsonRpcLocalServer);
+    return d->wireFormat;
+}
+
+void QJsonRpcLocalServer::setCompressionThreshold(int bytes)
+{
+    Q_D(QJsonRpcLocalServer);
+    d->compressionThreshold = bytes < 0 ? -1 : bytes;
+}
+
+int QJsonRpcLocalServer::compressionThreshold() const
+{
+    Q_D(const QJsonRpcLocalServer);
+    return d->compressionThreshold;
+}
+
+void QJsonRpcLocalServer::setCompressionDictionary(const QByteArray &dictionary)
+{
+    Q_D(QJsonRpcLocalServer);
+    if (!dictionary.isEmpty() && !QJsonRpcWireFormat::hasDictionarySupport()) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "built without zlib, ignoring compression dictionary";
+        return;
+    }
+
+    d->compressionDictionary = dictionary;
+}
+
+QByteArray QJsonRpcLocalServer::compressionDictionary() const
+{
+    Q_D(const QJsonRpcLocalServer);
+    return d->compressionDictionary;
+}
+
 bool QJsonRpcLocalServer::addService(QJsonRpcService *service)
 {
     if (!QJsonRpcServiceProvider::addService(service))
@@ -78,6 +125,9 @@ void QJsonRpcLocalServer::incomingConnection(quintptr socketDescriptor)
 
     QIODevice *device = qobject_cast<QIODevice*>(localSocket);
     QJsonRpcSocket *socket = new QJsonRpcSocket(device, this);
+    socket->setWireFormat(d->wireFormat);
+    socket->setCompressionThreshold(d->compressionThreshold);
+    socket->setCompressionDictionary(d->compressionDictionary);
     connect(socket, SIGNAL(messageReceived(QJsonRpcMessage)),
               this, SLOT(_q_processMessage(QJsonRpcMessage)));
     d->clients.append(socket);
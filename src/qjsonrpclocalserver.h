@@ -19,6 +19,7 @@
 
 #include <QLocalServer>
 #include "qjsonrpcabstractserver.h"
+#include "qjsonrpcsocket.h"
 
 class QJsonRpcLocalServerPrivate;
 class QJSONRPC_EXPORT QJsonRpcLocalServer : public QLocalServer, public QJsonRpcAbstractServer
@@ -30,6 +31,14 @@ public:
 
     virtual int connectedClientCount() const;
 
+    // applies to connections accepted afterwards
+    void setWireFormat(QJsonRpcSocket::WireFormat format);
+    QJsonRpcSocket::WireFormat wireFormat() const;
+    void setCompressionThreshold(int bytes);
+    int compressionThreshold() const;
+    void setCompressionDictionary(const QByteArray &dictionary);
+    QByteArray compressionDictionary() const;
+
     // reimp
     bool addService(QJsonRpcService *service);
     bool removeService(QJsonRpcService *service);
@@ -16,6 +16,8 @@
  */
 
 #include <QDebug>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 
 #if QT_VERSION >= 0x050000
 #   include <QJsonDocument>
@@ -23,44 +25,158 @@
 #   include "json/qjsondocument.h"
 #endif
 
+#include "qjsonrpcobjectpool_p.h"
+#include "qjsonrpcwireformat_p.h"
 #include "qjsonrpcmessage.h"
 
+// serializations of a message object, shared by the copies of a message until
+// one of them changes the object. Every slot is written once: the thread winning
+// the compare and swap on its state stores the bytes, readers take them after
+// seeing Ready and serialize on their own while another thread is still writing.
+struct QJsonRpcMessageEncodings
+{
+    QJSONRPC_DECLARE_POOLED_ALLOCATOR
+
+    enum { CompactJson, Cbor, MessagePack, BinaryJson, SlotCount };
+    enum State { Empty, Writing, Ready };
+
+    QJsonRpcMessageEncodings() : ref(1) {}
+
+    bool read(int slot, QByteArray *data) const
+    {
+        if (entries[slot].state.loadAcquire() != Ready)
+            return false;
+        *data = entries[slot].data;
+        return true;
+    }
+
+    void write(int slot, const QByteArray &data)
+    {
+        if (!entries[slot].state.testAndSetAcquire(Empty, Writing))
+            return;
+        entries[slot].data = data;
+        entries[slot].state.storeRelease(Ready);
+    }
+
+    struct Slot
+    {
+        Slot() : state(Empty) {}
+
+        QAtomicInt state;
+        QByteArray data;
+    };
+
+    QAtomicInt ref;
+    Slot entries[SlotCount];
+};
+
+QJSONRPC_DEFINE_POOLED_ALLOCATOR(QJsonRpcMessageEncodings)
+
 class QJsonRpcMessagePrivate : public QSharedData
 {
 public:
     QJsonRpcMessagePrivate();
     ~QJsonRpcMessagePrivate();
     QJsonRpcMessagePrivate(const QJsonRpcMessagePrivate &other);
+    QJSONRPC_DECLARE_POOLED_ALLOCATOR
 
     void initializeWithObject(const QJsonObject &message);
+    QJsonObject &mutableObject();
     static QJsonRpcMessage createBasicRequest(const QString &method, const QJsonArray &params);
     static QJsonRpcMessage createBasicRequest(const QString &method,
                                               const QJsonObject &namedParameters);
 
     QJsonRpcMessage::Type type;
-    QScopedPointer<QJsonObject> object;
+    QJsonObject object;
+    QList<QByteArray> attachments;
+    bool acceptsAttachments;
+
+    // filled on first use, reading them never takes a lock
+    QByteArray compactJson() const;
+    void setCompactJson(const QByteArray &json) const;
+    // created by the first serialization, a race is settled by compare and swap
+    QJsonRpcMessageEncodings *sharedEncodings() const;
+    void releaseEncodings();
+    mutable QAtomicPointer<QJsonRpcMessageEncodings> encodings;
 
     static int uniqueRequestCounter;
 };
 
 int QJsonRpcMessagePrivate::uniqueRequestCounter = 0;
 
+QJSONRPC_DEFINE_POOLED_ALLOCATOR(QJsonRpcMessagePrivate)
+
 QJsonRpcMessagePrivate::QJsonRpcMessagePrivate()
     : type(QJsonRpcMessage::Invalid),
-      object(0)
+      acceptsAttachments(false)
 {
 }
 
 QJsonRpcMessagePrivate::QJsonRpcMessagePrivate(const QJsonRpcMessagePrivate &other)
     : QSharedData(other),
       type(other.type),
-      object(other.object ? new QJsonObject(*other.object) : 0)
+      object(other.object),
+      attachments(other.attachments),
+      acceptsAttachments(other.acceptsAttachments),
+      encodings(nullptr)
+{
+    // the object is the same, so are its serializations
+    QJsonRpcMessageEncodings *shared = other.encodings.loadAcquire();
+    if (shared) {
+        shared->ref.ref();
+        encodings.storeRelease(shared);
+    }
+}
+
+QJsonObject &QJsonRpcMessagePrivate::mutableObject()
 {
+    // only called on a detached private, no other thread can see it
+    releaseEncodings();
+    return object;
+}
+
+QJsonRpcMessageEncodings *QJsonRpcMessagePrivate::sharedEncodings() const
+{
+    QJsonRpcMessageEncodings *shared = encodings.loadAcquire();
+    if (shared)
+        return shared;
+
+    shared = new QJsonRpcMessageEncodings;
+    if (encodings.testAndSetOrdered(nullptr, shared))
+        return shared;
+
+    delete shared;
+    return encodings.loadAcquire();
+}
+
+void QJsonRpcMessagePrivate::releaseEncodings()
+{
+    QJsonRpcMessageEncodings *shared = encodings.loadAcquire();
+    encodings.storeRelease(nullptr);
+    if (shared && !shared->ref.deref())
+        delete shared;
+}
+
+QByteArray QJsonRpcMessagePrivate::compactJson() const
+{
+    QJsonRpcMessageEncodings *shared = sharedEncodings();
+    QByteArray json;
+    if (shared->read(QJsonRpcMessageEncodings::CompactJson, &json))
+        return json;
+
+    json = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    shared->write(QJsonRpcMessageEncodings::CompactJson, json);
+    return json;
+}
+
+void QJsonRpcMessagePrivate::setCompactJson(const QByteArray &json) const
+{
+    sharedEncodings()->write(QJsonRpcMessageEncodings::CompactJson, json);
 }
 
 void QJsonRpcMessagePrivate::initializeWithObject(const QJsonObject &message)
 {
-    object.reset(new QJsonObject(message));
+    mutableObject() = message;
     if (message.contains(QLatin1String("id"))) {
         if (message.contains(QLatin1String("result")) ||
             message.contains(QLatin1String("error"))) {
@@ -80,12 +196,12 @@ void QJsonRpcMessagePrivate::initializeWithObject(const QJsonObject &message)
 
 QJsonRpcMessagePrivate::~QJsonRpcMessagePrivate()
 {
+    releaseEncodings();
 }
 
 QJsonRpcMessage::QJsonRpcMessage()
     : d(new QJsonRpcMessagePrivate)
 {
-    d->object.reset(new QJsonObject);
 }
 
 QJsonRpcMessage::QJsonRpcMessage(const QJsonRpcMessage &other)
@@ -156,19 +272,46 @@ QJsonRpcMessage QJsonRpcMessage::fromObject(const QJsonObject &message)
 
 QJsonObject QJsonRpcMessage::toObject() const
 {
-    if (d->object)
-        return QJsonObject(*d->object);
-    return QJsonObject();
+    return d->object;
 }
 
-QByteArray QJsonRpcMessage::toJson() const
+QByteArray QJsonRpcMessage::toJson(QJsonDocument::JsonFormat format) const
 {
-    if (d->object) {
-        QJsonDocument doc(*d->object);
-        return doc.toJson();
+    if (format == QJsonDocument::Compact)
+        return d->compactJson();
+
+    QJsonDocument doc(d->object);
+    return doc.toJson(format);
+}
+
+QByteArray QJsonRpcMessage::framePayload(int format) const
+{
+    int slot = QJsonRpcMessageEncodings::SlotCount;
+    switch (format) {
+    case QJsonRpcSocket::FramedJsonWireFormat:
+        return d->compactJson();
+    case QJsonRpcSocket::CborWireFormat:
+        slot = QJsonRpcMessageEncodings::Cbor;
+        break;
+    case QJsonRpcSocket::MessagePackWireFormat:
+        slot = QJsonRpcMessageEncodings::MessagePack;
+        break;
+    case QJsonRpcSocket::BinaryJsonWireFormat:
+        slot = QJsonRpcMessageEncodings::BinaryJson;
+        break;
+    default:
+        return QByteArray();
     }
 
-    return QByteArray();
+    const QJsonRpcSocket::WireFormat wireFormat = static_cast<QJsonRpcSocket::WireFormat>(format);
+    QJsonRpcMessageEncodings *shared = d->sharedEncodings();
+    QByteArray payload;
+    if (shared->read(slot, &payload))
+        return payload;
+
+    payload = QJsonRpcWireFormat::encodePayload(wireFormat, d->object);
+    shared->write(slot, payload);
+    return payload;
 }
 
 bool QJsonRpcMessage::isValid() const
@@ -184,10 +327,11 @@ QJsonRpcMessage::Type QJsonRpcMessage::type() const
 QJsonRpcMessage QJsonRpcMessagePrivate::createBasicRequest(const QString &method, const QJsonArray &params)
 {
     QJsonRpcMessage request;
-    request.d->object->insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
-    request.d->object->insert(QLatin1String("method"), method);
+    QJsonObject &object = request.d->mutableObject();
+    object.insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
+    object.insert(QLatin1String("method"), method);
     if (!params.isEmpty())
-        request.d->object->insert(QLatin1String("params"), params);
+        object.insert(QLatin1String("params"), params);
     return request;
 }
 
@@ -195,10 +339,11 @@ QJsonRpcMessage QJsonRpcMessagePrivate::createBasicRequest(const QString &method
                                                            const QJsonObject &namedParameters)
 {
     QJsonRpcMessage request;
-    request.d->object->insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
-    request.d->object->insert(QLatin1String("method"), method);
+    QJsonObject &object = request.d->mutableObject();
+    object.insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
+    object.insert(QLatin1String("method"), method);
     if (!namedParameters.isEmpty())
-        request.d->object->insert(QLatin1String("params"), namedParameters);
+        object.insert(QLatin1String("params"), namedParameters);
     return request;
 }
 
@@ -207,7 +352,7 @@ QJsonRpcMessage QJsonRpcMessage::createRequest(const QString &method, const QJso
     QJsonRpcMessage request = QJsonRpcMessagePrivate::createBasicRequest(method, params);
     request.d->type = QJsonRpcMessage::Request;
     QJsonRpcMessagePrivate::uniqueRequestCounter++;
-    request.d->object->insert(QLatin1String("id"), QJsonRpcMessagePrivate::uniqueRequestCounter);
+    request.d->mutableObject().insert(QLatin1String("id"), QJsonRpcMessagePrivate::uniqueRequestCounter);
     return request;
 }
 
@@ -225,7 +370,7 @@ QJsonRpcMessage QJsonRpcMessage::createRequest(const QString &method,
         QJsonRpcMessagePrivate::createBasicRequest(method, namedParameters);
     request.d->type = QJsonRpcMessage::Request;
     QJsonRpcMessagePrivate::uniqueRequestCounter++;
-    request.d->object->insert(QLatin1String("id"), QJsonRpcMessagePrivate::uniqueRequestCounter);
+    request.d->mutableObject().insert(QLatin1String("id"), QJsonRpcMessagePrivate::uniqueRequestCounter);
     return request;
 }
 
@@ -255,11 +400,11 @@ QJsonRpcMessage QJsonRpcMessage::createNotification(const QString &method,
 QJsonRpcMessage QJsonRpcMessage::createResponse(const QJsonValue &result) const
 {
     QJsonRpcMessage response;
-    if (d->object->contains(QLatin1String("id"))) {
-        QJsonObject *object = response.d->object.data();
-        object->insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
-        object->insert(QLatin1String("id"), d->object->value(QLatin1String("id")));
-        object->insert(QLatin1String("result"), result);
+    if (d->object.contains(QLatin1String("id"))) {
+        QJsonObject &object = response.d->mutableObject();
+        object.insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
+        object.insert(QLatin1String("id"), d->object.value(QLatin1String("id")));
+        object.insert(QLatin1String("result"), result);
         response.d->type = QJsonRpcMessage::Response;
     }
 
@@ -279,22 +424,125 @@ QJsonRpcMessage QJsonRpcMessage::createErrorResponse(QJsonRpc::ErrorCode code,
         error.insert(QLatin1String("data"), data);
 
     response.d->type = QJsonRpcMessage::Error;
-    QJsonObject *object = response.d->object.data();
-    object->insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
-    if (d->object->contains(QLatin1String("id")))
-        object->insert(QLatin1String("id"), d->object->value(QLatin1String("id")));
+    QJsonObject &object = response.d->mutableObject();
+    object.insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
+    if (d->object.contains(QLatin1String("id")))
+        object.insert(QLatin1String("id"), d->object.value(QLatin1String("id")));
     else
-        object->insert(QLatin1String("id"), 0);
-    object->insert(QLatin1String("error"), error);
+        object.insert(QLatin1String("id"), 0);
+    object.insert(QLatin1String("error"), error);
+    return response;
+}
+
+namespace {
+
+struct QJsonRpcErrorTemplate
+{
+    QJsonObject error;
+    QByteArray prefix;      // compact form up to the id value
+};
+
+class QJsonRpcErrorTemplates
+{
+public:
+    QJsonRpcErrorTemplates()
+    {
+        initialize(&parseError, QJsonRpc::ParseError, QLatin1String("parse error"));
+        initialize(&invalidRequest, QJsonRpc::InvalidRequest, QLatin1String("invalid request"));
+        initialize(&methodNotFound, QJsonRpc::MethodNotFound, QLatin1String("invalid method called"));
+        initialize(&invalidParams, QJsonRpc::InvalidParams, QLatin1String("invalid parameters"));
+        initialize(&internalError, QJsonRpc::InternalError, QLatin1String("internal error"));
+    }
+
+    const QJsonRpcErrorTemplate *find(QJsonRpc::ErrorCode code) const
+    {
+        switch (code) {
+        case QJsonRpc::ParseError:
+            return &parseError;
+        case QJsonRpc::InvalidRequest:
+            return &invalidRequest;
+        case QJsonRpc::MethodNotFound:
+            return &methodNotFound;
+        case QJsonRpc::InvalidParams:
+            return &invalidParams;
+        case QJsonRpc::InternalError:
+            return &internalError;
+        default:
+            return 0;
+        }
+    }
+
+private:
+    static void initialize(QJsonRpcErrorTemplate *errorTemplate, QJsonRpc::ErrorCode code,
+                           const QLatin1String &message)
+    {
+        errorTemplate->error.insert(QLatin1String("code"), code);
+        errorTemplate->error.insert(QLatin1String("message"), message);
+
+        // keys are serialized in sorted order: error, id, jsonrpc
+        errorTemplate->prefix = "{\"error\":";
+        errorTemplate->prefix += QJsonDocument(errorTemplate->error).toJson(QJsonDocument::Compact);
+        errorTemplate->prefix += ",\"id\":";
+    }
+
+    QJsonRpcErrorTemplate parseError;
+    QJsonRpcErrorTemplate invalidRequest;
+    QJsonRpcErrorTemplate methodNotFound;
+    QJsonRpcErrorTemplate invalidParams;
+    QJsonRpcErrorTemplate internalError;
+};
+
+}
+
+static QByteArray serializedId(const QJsonValue &id)
+{
+    if (id.isDouble()) {
+        // integers are exactly representable up to 2^53
+        const double value = id.toDouble();
+        if (value > -9007199254740992.0 && value < 9007199254740992.0 &&
+            value == static_cast<double>(static_cast<qint64>(value)))
+            return QByteArray::number(static_cast<qint64>(value));
+    }
+
+    QJsonArray wrapper;
+    wrapper.append(id);
+    const QByteArray json = QJsonDocument(wrapper).toJson(QJsonDocument::Compact);
+    return json.mid(1, json.size() - 2);
+}
+
+QJsonRpcMessage QJsonRpcMessage::createStandardErrorResponse(QJsonRpc::ErrorCode code) const
+{
+    static const QJsonRpcErrorTemplates templates;
+    const QJsonRpcErrorTemplate *errorTemplate = templates.find(code);
+    if (!errorTemplate)
+        return createErrorResponse(code, QLatin1String("server error"));
+
+    const QJsonValue id = d->object.contains(QLatin1String("id")) ?
+        d->object.value(QLatin1String("id")) : QJsonValue(0);
+
+    QJsonRpcMessage response;
+    response.d->type = QJsonRpcMessage::Error;
+    QJsonObject &object = response.d->mutableObject();
+    object.insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
+    object.insert(QLatin1String("id"), id);
+    object.insert(QLatin1String("error"), errorTemplate->error);
+
+    const QByteArray serialized = serializedId(id);
+    QByteArray json;
+    json.reserve(errorTemplate->prefix.size() + serialized.size() + 17);
+    json += errorTemplate->prefix;
+    json += serialized;
+    json += ",\"jsonrpc\":\"2.0\"}";
+    response.d->setCompactJson(json);
     return response;
 }
 
 int QJsonRpcMessage::id() const
 {
-    if (d->type == QJsonRpcMessage::Notification || !d->object)
+    if (d->type == QJsonRpcMessage::Notification)
         return -1;
 
-    const QJsonValue &value = d->object->value(QLatin1String("id"));
+    const QJsonValue &value = d->object.value(QLatin1String("id"));
     if (value.isString())
         return value.toString().toInt();
 #if QT_VERSION >= 0x050200
@@ -306,37 +554,114 @@ int QJsonRpcMessage::id() const
 
 QString QJsonRpcMessage::method() const
 {
-    if (d->type == QJsonRpcMessage::Response || !d->object)
+    if (d->type == QJsonRpcMessage::Response)
         return QString();
 
-    return d->object->value(QLatin1String("method")).toString();
+    return d->object.value(QLatin1String("method")).toString();
+}
+
+QList<QByteArray> QJsonRpcMessage::attachments() const
+{
+    return d->attachments;
+}
+
+void QJsonRpcMessage::setAttachments(const QList<QByteArray> &attachments)
+{
+    // not part of the envelope, the cached serialization stays valid
+    d->attachments = attachments;
+}
+
+bool QJsonRpcMessage::acceptsAttachments() const
+{
+    return d->acceptsAttachments;
+}
+
+void QJsonRpcMessage::setAcceptsAttachments(bool accepts)
+{
+    d->acceptsAttachments = accepts;
+}
+
+QJsonValue QJsonRpcMessage::attachmentReference(int index)
+{
+    QJsonObject reference;
+    reference.insert(QLatin1String("$attachment"), index);
+    return reference;
+}
+
+int QJsonRpcMessage::attachmentIndex(const QJsonValue &value)
+{
+    if (!value.isObject())
+        return -1;
+
+    const QJsonObject object = value.toObject();
+    if (object.size() != 1)
+        return -1;
+
+    const QJsonValue index = object.value(QLatin1String("$attachment"));
+    if (!index.isDouble() || index.toDouble() < 0 || index.toDouble() != index.toInt())
+        return -1;
+    return index.toInt();
+}
+
+static QJsonValue inlineAttachmentValue(const QJsonValue &value, const QList<QByteArray> &attachments)
+{
+    if (value.isArray()) {
+        QJsonArray array = value.toArray();
+        for (int i = 0; i < array.size(); ++i)
+            array.replace(i, inlineAttachmentValue(array.at(i), attachments));
+        return array;
+    }
+
+    if (!value.isObject())
+        return value;
+
+    const int index = QJsonRpcMessage::attachmentIndex(value);
+    if (index >= 0 && index < attachments.size())
+        return QString::fromLatin1(attachments.at(index).toBase64());
+
+    QJsonObject object = value.toObject();
+    for (QJsonObject::iterator it = object.begin(); it != object.end(); ++it)
+        it.value() = inlineAttachmentValue(it.value(), attachments);
+    return object;
+}
+
+QJsonRpcMessage QJsonRpcMessage::inlineAttachments() const
+{
+    if (d->attachments.isEmpty())
+        return *this;
+
+    QJsonRpcMessage message(*this);
+    QJsonObject &object = message.d->mutableObject();
+    const QLatin1String key(d->type == QJsonRpcMessage::Response ? "result" : "params");
+    if (object.contains(key))
+        object.insert(key, inlineAttachmentValue(object.value(key), d->attachments));
+    message.d->attachments.clear();
+    return message;
 }
 
 QJsonValue QJsonRpcMessage::params() const
 {
     if (d->type == QJsonRpcMessage::Response || d->type == QJsonRpcMessage::Error)
         return QJsonValue(QJsonValue::Undefined);
-    if (!d->object)
-        return QJsonValue(QJsonValue::Undefined);
 
-    return d->object->value(QLatin1String("params"));
+    return d->object.value(QLatin1String("params"));
 }
 
 QJsonValue QJsonRpcMessage::result() const
 {
-    if (d->type != QJsonRpcMessage::Response || !d->object)
+    if (d->type != QJsonRpcMessage::Response)
         return QJsonValue(QJsonValue::Undefined);
 
-    return d->object->value(QLatin1String("result"));
+    return d->object.value(QLatin1String("result"));
 }
 
 int QJsonRpcMessage::errorCode() const
 {
-    if (d->type != QJsonRpcMessage::Error || !d->object)
+    if (d->type != QJsonRpcMessage::Error)
         return 0;
 
     QJsonObject error =
-        d->object->value(QLatin1String("error")).toObject();
+        d->object.value(QLatin1String("error")).toObject();
     const QJsonValue &value = error.value(QLatin1String("code"));
     if (value.isString())
         return value.toString().toInt();
@@ -349,21 +674,21 @@ int QJsonRpcMessage::errorCode() const
 
 QString QJsonRpcMessage::errorMessage() const
 {
-    if (d->type != QJsonRpcMessage::Error || !d->object)
+    if (d->type != QJsonRpcMessage::Error)
         return QString();
 
     QJsonObject error =
-        d->object->value(QLatin1String("error")).toObject();
+        d->object.value(QLatin1String("error")).toObject();
     return error.value(QLatin1String("message")).toString();
 }
 
 QJsonValue QJsonRpcMessage::errorData() const
 {
-    if (d->type != QJsonRpcMessage::Error || !d->object)
+    if (d->type != QJsonRpcMessage::Error)
         return QJsonValue(QJsonValue::Undefined);
 
     QJsonObject error =
-        d->object->value(QLatin1String("error")).toObject();
+        d->object.value(QLatin1String("error")).toObject();
     return error.value(QLatin1String("data"));
 }
 
@@ -19,19 +19,258 @@
 
 #include <QSharedDataPointer>
 #include <QMetaType>
+#include <QStringList>
+#include <QVariant>
+#include <QHash>
+#include <QMap>
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 #if QT_VERSION >= 0x050000
 #include <QJsonValue>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QJsonDocument>
 #else
 #include "json/qjsonvalue.h"
 #include "json/qjsonobject.h"
 #include "json/qjsonarray.h"
+#include "json/qjsondocument.h"
 #endif
 
 #include "qjsonrpcglobal.h"
 
+namespace QJsonRpc {
+    // strict decoders behind JsonValueConverter::fromJson() for the types that
+    // convert to QJsonValue by construction, false if the JSON type differs
+    inline bool decodeJsonValue(const QJsonValue &value, QJsonValue *result)
+    { *result = value; return true; }
+    inline bool decodeJsonValue(const QJsonValue &value, bool *result)
+    { if (!value.isBool()) return false; *result = value.toBool(); return true; }
+    inline bool decodeJsonValue(const QJsonValue &value, double *result)
+    { if (!value.isDouble()) return false; *result = value.toDouble(); return true; }
+    inline bool decodeJsonValue(const QJsonValue &value, float *result)
+    { if (!value.isDouble()) return false; *result = float(value.toDouble()); return true; }
+    inline bool decodeJsonValue(const QJsonValue &value, QString *result)
+    { if (!value.isString()) return false; *result = value.toString(); return true; }
+    inline bool decodeJsonValue(const QJsonValue &value, QJsonObject *result)
+    { if (!value.isObject()) return false; *result = value.toObject(); return true; }
+    inline bool decodeJsonValue(const QJsonValue &value, QJsonArray *result)
+    { if (!value.isArray()) return false; *result = value.toArray(); return true; }
+
+    // the integer type an enum is stored in, integers stay what they are
+    template <typename T, bool = std::is_enum<T>::value>
+    struct IntegerType { typedef typename std::underlying_type<T>::type Type; };
+    template <typename T>
+    struct IntegerType<T, false> { typedef T Type; };
+
+    // compile-time conversion of native argument types to QJsonValue, used by the
+    // variadic request builders to avoid boxing every argument in a QVariant,
+    // and back again for the arguments of typed service methods
+    template <typename T, typename Enable = void>
+    struct JsonValueConverter
+    {
+        static QJsonValue toJson(const T &value) { return QJsonValue(value); }
+        static bool fromJson(const QJsonValue &value, T *result) { return decodeJsonValue(value, result); }
+    };
+
+    template <typename T>
+    struct JsonValueConverter<T, typename std::enable_if<(std::is_integral<T>::value &&
+                                                          !std::is_same<T, bool>::value) ||
+                                                         std::is_enum<T>::value>::type>
+    {
+        static QJsonValue toJson(T value) {
+            // unsigned 64-bit values don't fit a qint64, let them degrade to double
+            if (std::is_unsigned<T>::value && sizeof(T) >= sizeof(qint64))
+                return QJsonValue(static_cast<double>(value));
+            return QJsonValue(static_cast<qint64>(value));
+        }
+        // only whole numbers within the range of the type, the bounds are
+        // powers of two and exact as doubles even for 64 bit types
+        static bool fromJson(const QJsonValue &value, T *result) {
+            typedef typename IntegerType<T>::Type Integer;
+            if (!value.isDouble())
+                return false;
+            const double number = value.toDouble();
+            const double upper = std::ldexp(1.0, std::numeric_limits<Integer>::digits);
+            const double lower = std::is_signed<Integer>::value ? -upper : 0.0;
+            if (!(number >= lower && number < upper) || std::floor(number) != number)
+                return false;
+            *result = static_cast<T>(static_cast<Integer>(number));
+            return true;
+        }
+    };
+
+    // types following the qRegisterJsonRpcMetaType convention of a toJson() member
+    // and a static fromJson()
+    template <typename T>
+    struct JsonValueConverter<T, typename std::enable_if<
+        std::is_convertible<decltype(std::declval<const T &>().toJson()), QJsonValue>::value>::type>
+    {
+        static QJsonValue toJson(const T &value) { return value.toJson(); }
+        static bool fromJson(const QJsonValue &value, T *result) { *result = T::fromJson(value); return true; }
+    };
+
+    template <>
+    struct JsonValueConverter<QVariant>
+    {
+        static QJsonValue toJson(const QVariant &value) { return QJsonValue::fromVariant(value); }
+        static bool fromJson(const QJsonValue &value, QVariant *result) {
+            *result = value.toVariant();
+            return result->isValid();
+        }
+    };
+
+    template <>
+    struct JsonValueConverter<QStringList>
+    {
+        static QJsonValue toJson(const QStringList &value) { return QJsonArray::fromStringList(value); }
+        static bool fromJson(const QJsonValue &value, QStringList *result) {
+            if (!value.isArray())
+                return false;
+            const QJsonArray array = value.toArray();
+            QStringList list;
+            list.reserve(array.size());
+            for (QJsonArray::const_iterator it = array.constBegin(); it != array.constEnd(); ++it) {
+                if (!(*it).isString())
+                    return false;
+                list.append((*it).toString());
+            }
+            *result = list;
+            return true;
+        }
+    };
+
+    template <typename T>
+    inline QJsonValue toJsonValue(const T &value)
+    {
+        return JsonValueConverter<T>::toJson(value);
+    }
+
+    template <typename T>
+    inline bool fromJsonValue(const QJsonValue &value, T *result)
+    {
+        return JsonValueConverter<T>::fromJson(value, result);
+    }
+
+    template <typename T>
+    struct JsonValueConverter<QList<T> >
+    {
+        static QJsonValue toJson(const QList<T> &value) {
+            QJsonArray array;
+            for (typename QList<T>::const_iterator it = value.constBegin(); it != value.constEnd(); ++it)
+                array.append(toJsonValue(*it));
+            return array;
+        }
+        static bool fromJson(const QJsonValue &value, QList<T> *result) {
+            if (!value.isArray())
+                return false;
+            const QJsonArray array = value.toArray();
+            QList<T> list;
+            list.reserve(array.size());
+            for (QJsonArray::const_iterator it = array.constBegin(); it != array.constEnd(); ++it) {
+                T item;
+                if (!fromJsonValue(*it, &item))
+                    return false;
+                list.append(item);
+            }
+            *result = list;
+            return true;
+        }
+    };
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    template <typename T>
+    struct JsonValueConverter<QVector<T> >
+    {
+        static QJsonValue toJson(const QVector<T> &value) {
+            QJsonArray array;
+            for (typename QVector<T>::const_iterator it = value.constBegin(); it != value.constEnd(); ++it)
+                array.append(toJsonValue(*it));
+            return array;
+        }
+        static bool fromJson(const QJsonValue &value, QVector<T> *result) {
+            if (!value.isArray())
+                return false;
+            const QJsonArray array = value.toArray();
+            QVector<T> vector;
+            vector.reserve(array.size());
+            for (QJsonArray::const_iterator it = array.constBegin(); it != array.constEnd(); ++it) {
+                T item;
+                if (!fromJsonValue(*it, &item))
+                    return false;
+                vector.append(item);
+            }
+            *result = vector;
+            return true;
+        }
+    };
+#endif
+
+    template <typename T>
+    struct JsonValueConverter<QMap<QString, T> >
+    {
+        static QJsonValue toJson(const QMap<QString, T> &value) {
+            QJsonObject object;
+            for (typename QMap<QString, T>::const_iterator it = value.constBegin(); it != value.constEnd(); ++it)
+                object.insert(it.key(), toJsonValue(it.value()));
+            return object;
+        }
+        static bool fromJson(const QJsonValue &value, QMap<QString, T> *result) {
+            if (!value.isObject())
+                return false;
+            const QJsonObject object = value.toObject();
+            QMap<QString, T> map;
+            for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+                T item;
+                if (!fromJsonValue(it.value(), &item))
+                    return false;
+                map.insert(it.key(), item);
+            }
+            *result = map;
+            return true;
+        }
+    };
+
+    template <typename T>
+    struct JsonValueConverter<QHash<QString, T> >
+    {
+        static QJsonValue toJson(const QHash<QString, T> &value) {
+            QJsonObject object;
+            for (typename QHash<QString, T>::const_iterator it = value.constBegin(); it != value.constEnd(); ++it)
+                object.insert(it.key(), toJsonValue(it.value()));
+            return object;
+        }
+        static bool fromJson(const QJsonValue &value, QHash<QString, T> *result) {
+            if (!value.isObject())
+                return false;
+            const QJsonObject object = value.toObject();
+            QHash<QString, T> hash;
+            hash.reserve(object.size());
+            for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+                T item;
+                if (!fromJsonValue(it.value(), &item))
+                    return false;
+                hash.insert(it.key(), item);
+            }
+            *result = hash;
+            return true;
+        }
+    };
+
+    template <typename... Args>
+    inline QJsonArray toJsonArray(const Args &... args)
+    {
+        QJsonArray array;
+        const int expand[] = { 0, (array.append(toJsonValue(args)), 0)... };
+        Q_UNUSED(expand)
+        return array;
+    }
+}
+
 class QJsonRpcMessagePrivate;
 class QJSONRPC_EXPORT QJsonRpcMessage
 {
@@ -58,17 +297,41 @@ public:
     static QJsonRpcMessage createRequest(const QString &method, const QJsonValue &param);
     static QJsonRpcMessage createRequest(const QString &method, const QJsonObject &namedParameters);
 
+    // positional parameters of any type known to QJsonRpc::JsonValueConverter
+    template <typename T>
+    static typename std::enable_if<!std::is_convertible<T, QJsonValue>::value, QJsonRpcMessage>::type
+    createRequest(const QString &method, const T &param)
+    { return createRequest(method, QJsonRpc::toJsonArray(param)); }
+    template <typename T1, typename T2, typename... Args>
+    static QJsonRpcMessage createRequest(const QString &method, const T1 &param1, const T2 &param2,
+                                         const Args &... params)
+    { return createRequest(method, QJsonRpc::toJsonArray(param1, param2, params...)); }
+
     static QJsonRpcMessage createNotification(const QString &method,
                                               const QJsonArray &params = QJsonArray());
     static QJsonRpcMessage createNotification(const QString &method, const QJsonValue &param);
     static QJsonRpcMessage createNotification(const QString &method,
                                               const QJsonObject &namedParameters);
 
+    template <typename T>
+    static typename std::enable_if<!std::is_convertible<T, QJsonValue>::value, QJsonRpcMessage>::type
+    createNotification(const QString &method, const T &param)
+    { return createNotification(method, QJsonRpc::toJsonArray(param)); }
+    template <typename T1, typename T2, typename... Args>
+    static QJsonRpcMessage createNotification(const QString &method, const T1 &param1, const T2 &param2,
+                                              const Args &... params)
+    { return createNotification(method, QJsonRpc::toJsonArray(param1, param2, params...)); }
+
     QJsonRpcMessage createResponse(const QJsonValue &result) const;
     QJsonRpcMessage createErrorResponse(QJsonRpc::ErrorCode code,
                                         const QString &message = QString(),
                                         const QJsonValue &data = QJsonValue()) const;
 
+    // ParseError, InvalidRequest, MethodNotFound, InvalidParams and InternalError
+    // responses are built from preallocated templates, only the id is spliced into
+    // them. Other codes get a plain "server error" message.
+    QJsonRpcMessage createStandardErrorResponse(QJsonRpc::ErrorCode code) const;
+
     QJsonRpcMessage::Type type() const;
     bool isValid() const;
     int id() const;
@@ -88,14 +351,34 @@ public:
     QJsonObject toObject() const;
     static QJsonRpcMessage fromObject(const QJsonObject &object);
 
-    QByteArray toJson() const;
+    QByteArray toJson(QJsonDocument::JsonFormat format = QJsonDocument::Indented) const;
     static QJsonRpcMessage fromJson(const QByteArray &data);
 
+    // binary data carried next to the envelope by the framed wire formats,
+    // params and results point at it with attachmentReference(index)
+    QList<QByteArray> attachments() const;
+    void setAttachments(const QList<QByteArray> &attachments);
+    static QJsonValue attachmentReference(int index);
+    static int attachmentIndex(const QJsonValue &value);    // -1 for anything else
+
+    // for transports without attachment frames: references are replaced with
+    // the base64 encoded data and the attachments are dropped
+    QJsonRpcMessage inlineAttachments() const;
+
+    // set on messages read from a transport with attachment frames, services
+    // answer such requests with byte array results as attachments
+    bool acceptsAttachments() const;
+    void setAcceptsAttachments(bool accepts);
+
     bool operator==(const QJsonRpcMessage &message) const;
     inline bool operator!=(const QJsonRpcMessage &message) const { return !(operator==(message)); }
 
 private:
+    // encoded for a framed QJsonRpcSocket::WireFormat once, shared by all copies
+    QByteArray framePayload(int format) const;
+
     friend class QJsonRpcMessagePrivate;
+    friend class QJsonRpcWireFormat;
     QSharedDataPointer<QJsonRpcMessagePrivate> d;
 
 #if QT_VERSION < 0x050000
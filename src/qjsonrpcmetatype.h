@@ -19,6 +19,11 @@
 #define QJSONRPCMETATYPE_H
 
 #include <QMetaType>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QThread>
+
+#include "qjsonrpcservice.h"
 
 template <typename T>
 void qRegisterJsonRpcMetaType(const char *typeName, T * = 0)
@@ -28,4 +33,62 @@ void qRegisterJsonRpcMetaType(const char *typeName, T * = 0)
     QMetaType::registerConverter<QJsonValue, T>(&T::fromJson);
 }
 
+namespace QJsonRpc {
+    // answers request once the QFuture a slot returned has finished, the
+    // response is sent from thread
+    typedef void (*FutureResponder)(const void *future, const QJsonRpcServiceRequest &request,
+                                    QThread *thread);
+    QJSONRPC_EXPORT void registerFutureResponder(int type, FutureResponder responder);
+
+    template <typename T>
+    struct FutureResult
+    {
+        static QJsonValue take(const QFuture<T> &future) { return toJsonValue(future.result()); }
+    };
+
+    template <>
+    struct FutureResult<void>
+    {
+        static QJsonValue take(const QFuture<void> &) { return QJsonValue(); }
+    };
+
+    template <typename T>
+    void respondWhenFinished(const void *future, const QJsonRpcServiceRequest &request, QThread *thread)
+    {
+        QFutureWatcher<T> *watcher = new QFutureWatcher<T>;
+        watcher->moveToThread(thread);
+        QJsonRpcServiceRequest pending(request);
+        QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, [watcher, pending]() mutable {
+            const QJsonRpcMessage message = pending.request();
+            if (watcher->isCanceled()) {
+                pending.respond(message.createErrorResponse(QJsonRpc::InternalError,
+                                                            QStringLiteral("the result was canceled")));
+            } else {
+                pending.respond(message.createResponse(FutureResult<T>::take(watcher->future())));
+            }
+            watcher->deleteLater();
+        });
+
+        // the watcher is set up on its own thread, the caller may be a pool thread
+        const QFuture<T> result = *static_cast<const QFuture<T> *>(future);
+        if (thread == QThread::currentThread()) {
+            watcher->setFuture(result);
+        } else {
+            QMetaObject::invokeMethod(watcher, [watcher, result]() {
+                watcher->setFuture(result);
+            }, Qt::QueuedConnection);
+        }
+    }
+}
+
+// lets service slots return QFuture<T>, their response is sent once the future
+// finished without blocking the server. T has to be known to
+// QJsonRpc::JsonValueConverter, register before adding the services.
+template <typename T>
+void qRegisterJsonRpcFutureType(const char *typeName)
+{
+    const int type = qRegisterMetaType<QFuture<T> >(typeName);
+    QJsonRpc::registerFutureResponder(type, &QJsonRpc::respondWhenFinished<T>);
+}
+
 #endif
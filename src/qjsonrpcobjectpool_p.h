@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2012-2013 Matt Broadstone
+ * Contact: http://bitbucket.org/devonit/qjsonrpc
+ *
+ * This file is part of the QJsonRpc Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef QJSONRPCOBJECTPOOL_P_H
+#define QJSONRPCOBJECTPOOL_P_H
+
+#include <new>
+#include <cstddef>
+
+#include "qjsonrpcglobal.h"
+
+// counters shared by all pools of the calling thread
+struct QJsonRpcObjectPoolStatistics
+{
+    quint64 heapAllocations;
+    quint64 pooledAllocations;
+};
+
+QJSONRPC_EXPORT QJsonRpcObjectPoolStatistics &qJsonRpcObjectPoolStatistics();
+
+/*
+ * Per-thread free list for the fixed size bookkeeping objects created for every
+ * message (message, request and reply privates). Blocks are recycled on the
+ * thread releasing them, subclasses with a different size bypass the pool.
+ */
+template <typename T>
+class QJsonRpcObjectPool
+{
+public:
+    enum { MaximumFreeBlocks = 1024 };
+
+    static void *allocate(std::size_t size)
+    {
+        FreeList &list = freeList();
+        if (size == sizeof(T) && list.head) {
+            Node *node = list.head;
+            list.head = node->next;
+            --list.count;
+            ++qJsonRpcObjectPoolStatistics().pooledAllocations;
+            return node;
+        }
+
+        if (!list.disabled)
+            ensureDrainer();
+        ++qJsonRpcObjectPoolStatistics().heapAllocations;
+        return ::operator new(size);
+    }
+
+    static void release(void *block, std::size_t size)
+    {
+        if (!block)
+            return;
+
+        FreeList &list = freeList();
+        if (size == sizeof(T) && !list.disabled && list.count < MaximumFreeBlocks) {
+            Node *node = static_cast<Node*>(block);
+            node->next = list.head;
+            list.head = node;
+            ++list.count;
+            return;
+        }
+
+        ::operator delete(block);
+    }
+
+private:
+    struct Node { Node *next; };
+    Q_STATIC_ASSERT(sizeof(T) >= sizeof(Node));
+
+    // trivially destructible so it stays usable while the thread is torn down,
+    // the drainer below returns the cached blocks to the heap on thread exit
+    struct FreeList
+    {
+        Node *head;
+        int count;
+        bool disabled;
+    };
+
+    struct Drainer
+    {
+        ~Drainer() {
+            FreeList &list = freeList();
+            list.disabled = true;
+            while (list.head) {
+                Node *node = list.head;
+                list.head = node->next;
+                ::operator delete(node);
+            }
+            list.count = 0;
+        }
+    };
+
+    static FreeList &freeList()
+    {
+        static thread_local FreeList list = { nullptr, 0, false };
+        return list;
+    }
+
+    static void ensureDrainer()
+    {
+        static thread_local Drainer drainer;
+        Q_UNUSED(drainer)
+    }
+};
+
+#define QJSONRPC_DECLARE_POOLED_ALLOCATOR \
+    static void *operator new(std::size_t size); \
+    static void operator delete(void *block, std::size_t size);
+
+#define QJSONRPC_DEFINE_POOLED_ALLOCATOR(Class) \
+    void *Class::operator new(std::size_t size) \
+    { return QJsonRpcObjectPool<Class>::allocate(size); } \
+    void Class::operator delete(void *block, std::size_t size) \
+    { QJsonRpcObjectPool<Class>::release(block, size); }
+
+#endif
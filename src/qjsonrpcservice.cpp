@@ -15,16 +15,26 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
  * Lesser General Public License for more details.
  */
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
 #include <QVarLengthArray>
 #include <QMetaMethod>
+#include <QMetaClassInfo>
 #include <QEventLoop>
 #include <QDebug>
 #include <QJSValue>
+#include <QMutex>
+#include <QRunnable>
+#include <QThread>
 
 #include "qjsonrpcsocket.h"
 #include "qjsonrpcservice_p.h"
 #include "qjsonrpcservice.h"
 
+QJSONRPC_DEFINE_POOLED_ALLOCATOR(QJsonRpcServiceRequestPrivate)
+
 QJsonRpcServiceRequest::QJsonRpcServiceRequest()
     : d(new QJsonRpcServiceRequestPrivate)
 {
@@ -65,7 +75,7 @@ QJsonRpcMessage QJsonRpcServiceRequest::request() const
 
 QJsonRpcAbstractSocket *QJsonRpcServiceRequest::socket() const
 {
-    return d->socket;
+    return d->peer ? d->peer.data() : d->socket.data();
 }
 
 bool QJsonRpcServiceRequest::respond(QVariant returnValue)
@@ -75,8 +85,7 @@ bool QJsonRpcServiceRequest::respond(QVariant returnValue)
         return false;
     }
 
-    QJsonRpcMessage response =
-        d->request.createResponse(QJsonRpcServicePrivate::convertReturnValue(returnValue));
+    QJsonRpcMessage response = QJsonRpcServicePrivate::createResponse(d->request, returnValue);
     return respond(response);
 }
 
@@ -95,19 +104,40 @@ QJsonRpcServicePrivate::ParameterInfo::ParameterInfo(const QString &n, int t, bo
     : type(t),
       jsType(convertVariantTypeToJSType(t)),
       name(n),
-      out(o)
+      out(o),
+      convert(argumentConverter(t)),
+      offset(0)
 {
 }
 
+static inline int metaTypeSize(int type)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return int(QMetaType(type).sizeOf());
+#else
+    return QMetaType::sizeOf(type);
+#endif
+}
+
 QJsonRpcServicePrivate::MethodInfo::MethodInfo()
-    : returnType(QMetaType::Void),
+    : index(-1),
+      argumentStorageSize(0),
+      returnValueOffset(0),
+      returnType(QMetaType::Void),
+      encodeReturnValue(returnValueEncoder(QMetaType::Void)),
+      respondToFuture(0),
       valid(false),
       hasOut(false)
 {
 }
 
-QJsonRpcServicePrivate::MethodInfo::MethodInfo(const QMetaMethod &method)
-    : returnType(QMetaType::Void),
+QJsonRpcServicePrivate::MethodInfo::MethodInfo(const QMetaMethod &method, int methodIndex)
+    : index(methodIndex),
+      argumentStorageSize(0),
+      returnValueOffset(0),
+      returnType(QMetaType::Void),
+      encodeReturnValue(0),
+      respondToFuture(0),
       valid(true),
       hasOut(false)
 {
@@ -146,8 +176,19 @@ QJsonRpcServicePrivate::MethodInfo::MethodInfo(const QMetaMethod &method)
             break;
         }
 
-        parameters.append(ParameterInfo(QString::fromUtf8(parameterName), type, out));
+        ParameterInfo parameter(QString::fromUtf8(parameterName), type, out);
+        parameter.offset = argumentStorageSize;
+        const int alignment = int(alignof(std::max_align_t));
+        argumentStorageSize += (metaTypeSize(type) + alignment - 1) / alignment * alignment;
+        parameters.append(parameter);
+        parameterIndexes.insert(parameter.name, i);
     }
+
+    returnValueOffset = argumentStorageSize;
+    if (returnType != QMetaType::Void)
+        argumentStorageSize += metaTypeSize(returnType);
+    encodeReturnValue = returnValueEncoder(returnType);
+    respondToFuture = futureResponder(returnType);
 }
 
 QJsonRpcService::QJsonRpcService(QObject *parent)
@@ -162,18 +203,190 @@ QJsonRpcService::QJsonRpcService(QObject *parent)
 
 QJsonRpcService::~QJsonRpcService()
 {
+    // too late for the slots of a subclass, the provider waits when the
+    // service is removed or the provider goes away
+    waitForJobs();
+}
+
+void QJsonRpcService::waitForJobs()
+{
+    Q_D(QJsonRpcService);
+    QMutexLocker locker(&d->jobLock);
+    while (d->activeJobs > 0)
+        d->jobsFinished.wait(&d->jobLock);
+}
+
+static thread_local QJsonRpcServicePrivate::RequestContext *currentContext = nullptr;
+
+QJsonRpcServicePrivate::RequestContext::RequestContext(const QJsonRpcServicePrivate *s,
+                                                       const QJsonRpcMessage &r,
+                                                       QJsonRpcAbstractSocket *sock,
+                                                       QJsonRpcAbstractSocket *p)
+    : service(s),
+      request(r),
+      socket(sock),
+      peer(p),
+      delayed(false),
+      previous(currentContext)
+{
+    currentContext = this;
+}
+
+QJsonRpcServicePrivate::RequestContext::~RequestContext()
+{
+    currentContext = previous;
+}
+
+QJsonRpcServicePrivate::RequestContext *
+QJsonRpcServicePrivate::RequestContext::find(const QJsonRpcServicePrivate *service)
+{
+    for (RequestContext *context = currentContext; context; context = context->previous) {
+        if (context->service == service)
+            return context;
+    }
+
+    return nullptr;
 }
 
 QJsonRpcServiceRequest QJsonRpcService::currentRequest() const
 {
     Q_D(const QJsonRpcService);
-    return d->currentRequest;
+    const QJsonRpcServicePrivate::RequestContext *context =
+        QJsonRpcServicePrivate::RequestContext::find(d);
+    if (!context)
+        return QJsonRpcServiceRequest();
+    return QJsonRpcServicePrivate::serviceRequest(context->request, context->socket, context->peer);
 }
 
 void QJsonRpcService::beginDelayedResponse()
 {
     Q_D(QJsonRpcService);
-    d->delayedResponse = true;
+    QJsonRpcServicePrivate::RequestContext *context = QJsonRpcServicePrivate::RequestContext::find(d);
+    if (!context) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "called outside of a dispatched method";
+        return;
+    }
+
+    context->delayed = true;
+}
+
+bool QJsonRpcService::registerInvoker(const QByteArray &name, int argumentCount,
+                                      const QStringList &parameterNames,
+                                      const QJsonRpc::MethodInvoker &invoker)
+{
+    Q_D(QJsonRpcService);
+    if (name.isEmpty() || name.contains('.')) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "invalid method name" << name;
+        return false;
+    }
+
+    if (!parameterNames.isEmpty() && parameterNames.size() != argumentCount) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "method" << name << "takes" << argumentCount
+                        << "arguments, got" << parameterNames.size() << "parameter names";
+        return false;
+    }
+
+    QSharedPointer<QJsonRpcServicePrivate::TypedMethod> method(new QJsonRpcServicePrivate::TypedMethod);
+    method->invoke = invoker;
+    method->argumentCount = argumentCount;
+    method->parameterNames = parameterNames;
+    for (int i = 0; i < parameterNames.size(); ++i) {
+        if (method->parameterIndexes.contains(parameterNames.at(i))) {
+            qJsonRpcDebug() << Q_FUNC_INFO << "duplicate parameter name" << parameterNames.at(i);
+            return false;
+        }
+        method->parameterIndexes.insert(parameterNames.at(i), i);
+    }
+
+    QMutexLocker locker(&d->methodLock);
+    d->typedMethods.insert(name, method);
+    return true;
+}
+
+bool QJsonRpcService::unregisterMethod(const QByteArray &name)
+{
+    Q_D(QJsonRpcService);
+    QMutexLocker locker(&d->methodLock);
+    return d->typedMethods.remove(name) > 0;
+}
+
+QSharedPointer<const QJsonRpcServicePrivate::Metadata> QJsonRpcServicePrivate::methodTable() const
+{
+    QMutexLocker locker(&methodLock);
+    return metadata;
+}
+
+QHash<QByteArray, QSharedPointer<const QJsonRpcServicePrivate::TypedMethod> >
+QJsonRpcServicePrivate::typedMethodTable() const
+{
+    QMutexLocker locker(&methodLock);
+    return typedMethods;
+}
+
+void QJsonRpcService::setThreadPool(QThreadPool *pool)
+{
+    Q_D(QJsonRpcService);
+    d->threadPool = pool;
+    d->threadPoolSet = true;
+}
+
+QThreadPool *QJsonRpcService::threadPool() const
+{
+    Q_D(const QJsonRpcService);
+    return d->threadPool;
+}
+
+void QJsonRpcService::setResultCaching(const QByteArray &method, int ttl, int maxEntries)
+{
+    Q_D(QJsonRpcService);
+    d->setResultCaching(method, ttl, maxEntries);
+}
+
+void QJsonRpcService::invalidateCachedResults(const QByteArray &method)
+{
+    Q_D(QJsonRpcService);
+    QMutexLocker locker(&d->resultCacheLock);
+    if (method.isEmpty()) {
+        for (auto it = d->resultCaches.begin(); it != d->resultCaches.end(); ++it)
+            it.value()->entries.clear();
+        return;
+    }
+
+    const QSharedPointer<QJsonRpcServicePrivate::ResultCache> cache = d->resultCaches.value(method);
+    if (cache)
+        cache->entries.clear();
+}
+
+void QJsonRpcService::setSingleFlight(const QByteArray &method, bool enabled)
+{
+    Q_D(QJsonRpcService);
+    QMutexLocker locker(&d->singleFlightLock);
+    if (enabled)
+        d->singleFlightMethods.insert(method);
+    else
+        d->singleFlightMethods.remove(method);
+}
+
+bool QJsonRpcService::isSingleFlight(const QByteArray &method) const
+{
+    Q_D(const QJsonRpcService);
+    QMutexLocker locker(&d->singleFlightLock);
+    return d->singleFlightMethods.contains(method);
+}
+
+QJsonRpcService::CacheStatistics QJsonRpcService::cacheStatistics(const QByteArray &method) const
+{
+    Q_D(const QJsonRpcService);
+    CacheStatistics statistics = { 0, 0, 0 };
+    QMutexLocker locker(&d->resultCacheLock);
+    const QSharedPointer<QJsonRpcServicePrivate::ResultCache> cache = d->resultCaches.value(method);
+    if (cache) {
+        statistics.hits = cache->hits;
+        statistics.misses = cache->misses;
+        statistics.entries = int(cache->entries.count());
+    }
+
+    return statistics;
 }
 
 int QJsonRpcServicePrivate::convertVariantTypeToJSType(int type)
@@ -212,8 +425,78 @@ int QJsonRpcServicePrivate::qjsonRpcMessageType = qRegisterMetaType<QJsonRpcMess
 void QJsonRpcServicePrivate::cacheInvokableInfo()
 {
     Q_Q(QJsonRpcService);
-    const QMetaObject *obj = q->metaObject();
-    int startIdx = q->staticMetaObject.methodCount(); // skip QObject slots
+    {
+        QMutexLocker locker(&overloadCacheLock);
+        overloadCache.clear();
+    }
+    QSharedPointer<const Metadata> methods =
+        sharedMetadata(q->metaObject(), q->staticMetaObject.methodCount()); // skip QObject slots
+    {
+        QMutexLocker locker(&methodLock);
+        metadata = methods;
+    }
+
+    // classinfo caching only applies to methods not set up through the API
+    const QMetaObject *metaObject = q->metaObject();
+    for (int i = 0; i < metaObject->classInfoCount(); ++i) {
+        const QMetaClassInfo classInfo = metaObject->classInfo(i);
+        const QByteArray name(classInfo.name());
+        if (!name.startsWith("cache."))
+            continue;
+
+        const QByteArray method = name.mid(6);
+        const QList<QByteArray> values = QByteArray(classInfo.value()).split(',');
+        bool ttlValid = false;
+        bool sizeValid = true;
+        const int ttl = values.at(0).trimmed().toInt(&ttlValid);
+        const int maxEntries = values.size() > 1 ?
+            values.at(1).trimmed().toInt(&sizeValid) : int(DefaultResultCacheSize);
+        if (!ttlValid || !sizeValid || values.size() > 2) {
+            qJsonRpcDebug() << "QJsonRpcService: invalid cache settings for" << method << classInfo.value();
+            continue;
+        }
+
+        bool configured = false;
+        {
+            QMutexLocker locker(&resultCacheLock);
+            configured = resultCaches.contains(method);
+        }
+        if (!configured)
+            setResultCaching(method, ttl, maxEntries);
+    }
+
+    const int singleFlight = metaObject->indexOfClassInfo("singleflight");
+    if (singleFlight >= 0) {
+        const QList<QByteArray> methods = QByteArray(metaObject->classInfo(singleFlight).value()).split(',');
+        QMutexLocker locker(&singleFlightLock);
+        for (const QByteArray &method : methods) {
+            if (!method.trimmed().isEmpty())
+                singleFlightMethods.insert(method.trimmed());
+        }
+    }
+
+    if (!threadPoolSet) {
+        const int concurrency = metaObject->indexOfClassInfo("concurrency");
+        if (concurrency >= 0 &&
+            qstrcmp(metaObject->classInfo(concurrency).value(), "threadpool") == 0)
+            threadPool = QThreadPool::globalInstance();
+    }
+}
+
+QSharedPointer<const QJsonRpcServicePrivate::Metadata>
+QJsonRpcServicePrivate::sharedMetadata(const QMetaObject *obj, int startIdx)
+{
+    static QMutex registryLock;
+    static QHash<const QMetaObject *, QWeakPointer<const Metadata> > registry;
+
+    QMutexLocker locker(&registryLock);
+    QSharedPointer<const Metadata> existing = registry.value(obj).toStrongRef();
+    if (existing && existing->metaData == obj->d.data && existing->stringData == obj->d.stringdata)
+        return existing;
+
+    QHash<int, MethodInfo> methodInfoHash;
+    QHash<QByteArray, QList<int> > invokableMethodHash;
+    QList<QByteArray> methodNames;
     for (int idx = startIdx; idx < obj->methodCount(); ++idx) {
         const QMetaMethod method = obj->method(idx);
         if ((method.methodType() == QMetaMethod::Slot &&
@@ -228,10 +511,12 @@ void QJsonRpcServicePrivate::cacheInvokableInfo()
             QByteArray methodName = signature.left(signature.indexOf('('));
 #endif
 
-            MethodInfo info(method);
+            MethodInfo info(method, idx);
             if (!info.valid)
                 continue;
 
+            if (!invokableMethodHash.contains(methodName))
+                methodNames.append(methodName);
             if (signature.contains("QVariant"))
                 invokableMethodHash[methodName].append(idx);
             else
@@ -239,6 +524,112 @@ void QJsonRpcServicePrivate::cacheInvokableInfo()
             methodInfoHash[idx] = info;
         }
     }
+
+    // freeze the tables into contiguous arrays
+    QSharedPointer<Metadata> metadata(new Metadata);
+    metadata->metaData = obj->d.data;
+    metadata->stringData = obj->d.stringdata;
+    metadata->methods.reserve(methodInfoHash.size());
+    metadata->groups.reserve(methodNames.size());
+    for (const QByteArray &methodName : qAsConst(methodNames)) {
+        const QList<int> &overloads = invokableMethodHash[methodName];
+        MethodGroup group;
+        group.name = methodName;
+        group.first = metadata->methods.size();
+        group.count = overloads.size();
+        for (int idx : overloads)
+            metadata->methods.append(methodInfoHash.value(idx));
+        metadata->groups.append(group);
+    }
+    metadata->buildLookup();
+
+    // dynamic meta objects come and go with their instances
+    for (QHash<const QMetaObject *, QWeakPointer<const Metadata> >::iterator it = registry.begin();
+         it != registry.end();) {
+        if (it.value().isNull())
+            it = registry.erase(it);
+        else
+            ++it;
+    }
+
+    registry.insert(obj, metadata);
+    return metadata;
+}
+
+static inline uint methodNameHash(const QByteArray &name, uint seed)
+{
+    return uint(qHash(name, seed));
+}
+
+int QJsonRpcServicePrivate::Metadata::findGroup(const QByteArray &name) const
+{
+    const uint bucket = methodNameHash(name, 0) & uint(seeds.size() - 1);
+    const int group = lookupTable.at(int(methodNameHash(name, seeds.at(int(bucket))) &
+                                         uint(lookupTable.size() - 1)));
+    if (group < 0 || groups.at(group).name != name)
+        return -1;
+    return group;
+}
+
+// hash and displace: names are spread over buckets by a first hash, then each
+// bucket, largest first, searches a seed placing all of its names in free slots
+void QJsonRpcServicePrivate::Metadata::buildLookup()
+{
+    int tableSize = 1;
+    while (tableSize < groups.size())
+        tableSize <<= 1;
+
+    for (;; tableSize <<= 1) {
+        QVector<QVector<int> > buckets(tableSize);
+        for (int i = 0; i < groups.size(); ++i)
+            buckets[int(methodNameHash(groups.at(i).name, 0) & uint(tableSize - 1))].append(i);
+
+        QVector<int> order(tableSize);
+        for (int i = 0; i < tableSize; ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&buckets](int a, int b) {
+            return buckets.at(a).size() > buckets.at(b).size();
+        });
+
+        seeds.fill(0, tableSize);
+        lookupTable.fill(-1, tableSize);
+        bool complete = true;
+        for (int bucket : qAsConst(order)) {
+            const QVector<int> &members = buckets.at(bucket);
+            if (members.isEmpty())
+                break;
+
+            bool placed = false;
+            for (uint seed = 1; seed < 4096 && !placed; ++seed) {
+                QVarLengthArray<int, 8> positions;
+                placed = true;
+                for (int member : members) {
+                    const int position =
+                        int(methodNameHash(groups.at(member).name, seed) & uint(tableSize - 1));
+                    if (lookupTable.at(position) != -1 ||
+                        std::find(positions.begin(), positions.end(), position) != positions.end()) {
+                        placed = false;
+                        break;
+                    }
+                    positions.append(position);
+                }
+
+                if (placed) {
+                    seeds[bucket] = seed;
+                    for (int i = 0; i < members.size(); ++i)
+                        lookupTable[positions.at(i)] = members.at(i);
+                }
+            }
+
+            if (!placed) {
+                complete = false;
+                break;
+            }
+        }
+
+        if (complete)
+            return;
+    }
 }
 
 static bool jsParameterCompare(const QJsonArray &parameters,
@@ -333,6 +724,148 @@ static inline QVariant convertArgument(const QJsonValue &argument,
 #endif
 }
 
+static bool convertGeneric(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &info,
+                           void *argument)
+{
+    QVariant result = convertArgument(value, info);
+    if (result.userType() != info.type && info.type >= QMetaType::User) {
+        // converters registered from the plain form of the value, a QString say
+        QVariant plain = value.toVariant();
+        if (plain.canConvert(info.type) && plain.convert(info.type))
+            result = plain;
+    }
+
+    // the argument is constructed from the variant's data, it has to be a T
+    if (!result.isValid() || result.userType() != info.type)
+        return false;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    const QMetaType metaType(info.type);
+    metaType.destruct(argument);
+    metaType.construct(argument, result.constData());
+#else
+    QMetaType::destruct(info.type, argument);
+    QMetaType::construct(info.type, argument, result.constData());
+#endif
+    return true;
+}
+
+static inline qint64 jsonToInteger(const QJsonValue &value)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // keeps 64 bit integers exact, fractions are rounded like QVariant does
+    return value.toInteger(qRound64(value.toDouble()));
+#else
+    return qRound64(value.toDouble());
+#endif
+}
+
+template <typename T>
+static bool convertInteger(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &info,
+                           void *argument)
+{
+    if (!value.isDouble())
+        return convertGeneric(value, info, argument);
+    *static_cast<T *>(argument) = static_cast<T>(jsonToInteger(value));
+    return true;
+}
+
+template <typename T>
+static bool convertFloatingPoint(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &info,
+                                 void *argument)
+{
+    if (!value.isDouble())
+        return convertGeneric(value, info, argument);
+    *static_cast<T *>(argument) = static_cast<T>(value.toDouble());
+    return true;
+}
+
+static bool convertBool(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &info,
+                        void *argument)
+{
+    if (!value.isBool())
+        return convertGeneric(value, info, argument);
+    *static_cast<bool *>(argument) = value.toBool();
+    return true;
+}
+
+static bool convertString(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &info,
+                          void *argument)
+{
+    if (!value.isString())
+        return convertGeneric(value, info, argument);
+    *static_cast<QString *>(argument) = value.toString();
+    return true;
+}
+
+static bool convertJsonValue(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &,
+                             void *argument)
+{
+    *static_cast<QJsonValue *>(argument) = value;
+    return true;
+}
+
+static bool convertJsonObject(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &info,
+                              void *argument)
+{
+    if (!value.isObject())
+        return convertGeneric(value, info, argument);
+    *static_cast<QJsonObject *>(argument) = value.toObject();
+    return true;
+}
+
+static bool convertJsonArray(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &info,
+                             void *argument)
+{
+    if (!value.isArray())
+        return convertGeneric(value, info, argument);
+    *static_cast<QJsonArray *>(argument) = value.toArray();
+    return true;
+}
+
+static bool convertVariant(const QJsonValue &value, const QJsonRpcServicePrivate::ParameterInfo &,
+                           void *argument)
+{
+    QVariant &variant = *static_cast<QVariant *>(argument);
+    variant = value.toVariant();
+    return variant.isValid();
+}
+
+QJsonRpcServicePrivate::ArgumentConverter QJsonRpcServicePrivate::argumentConverter(int type)
+{
+    switch (type) {
+    case QMetaType::Int:
+        return convertInteger<int>;
+    case QMetaType::UInt:
+        return convertInteger<uint>;
+    case QMetaType::LongLong:
+        return convertInteger<qlonglong>;
+    case QMetaType::ULongLong:
+        return convertInteger<qulonglong>;
+    case QMetaType::Double:
+        return convertFloatingPoint<double>;
+    case QMetaType::Float:
+        return convertFloatingPoint<float>;
+    case QMetaType::Bool:
+        return convertBool;
+    case QMetaType::QString:
+        return convertString;
+    case QMetaType::QJsonValue:
+        return convertJsonValue;
+    case QMetaType::QJsonObject:
+        return convertJsonObject;
+    case QMetaType::QJsonArray:
+        return convertJsonArray;
+    case QMetaType::QVariant:
+        return convertVariant;
+    default:
+        break;
+    }
+
+    // everything else goes through the QMetaType converter registry
+    return convertGeneric;
+}
+
 QJsonValue QJsonRpcServicePrivate::convertReturnValue(QVariant &returnValue)
 {
 #if QT_VERSION >= 0x050200
@@ -368,6 +901,172 @@ QJsonValue QJsonRpcServicePrivate::convertReturnValue(QVariant &returnValue)
 #endif
 }
 
+static QJsonValue encodeVoid(int, const void *)
+{
+    return QJsonValue();
+}
+
+template <typename T>
+static QJsonValue encodeDirect(int, const void *value)
+{
+    return QJsonValue(*static_cast<const T *>(value));
+}
+
+static QJsonValue encodeUInt(int, const void *value)
+{
+    return QJsonValue(qint64(*static_cast<const uint *>(value)));
+}
+
+static QJsonValue encodeULongLong(int, const void *value)
+{
+    const qulonglong number = *static_cast<const qulonglong *>(value);
+    if (number > qulonglong(std::numeric_limits<qint64>::max()))
+        return QJsonValue(double(number));
+    return QJsonValue(qint64(number));
+}
+
+static QJsonValue encodeFloat(int, const void *value)
+{
+    return QJsonValue(double(*static_cast<const float *>(value)));
+}
+
+static QJsonValue encodeStringList(int, const void *value)
+{
+    return QJsonArray::fromStringList(*static_cast<const QStringList *>(value));
+}
+
+static QJsonValue encodeVariantList(int, const void *value)
+{
+    return QJsonArray::fromVariantList(*static_cast<const QVariantList *>(value));
+}
+
+static QJsonValue encodeVariantMap(int, const void *value)
+{
+    return QJsonObject::fromVariantMap(*static_cast<const QVariantMap *>(value));
+}
+
+static QJsonValue encodeGeneric(int type, const void *value)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    QVariant variant(QMetaType(type), value);
+#else
+    QVariant variant(type, value);
+#endif
+    return QJsonRpcServicePrivate::convertReturnValue(variant);
+}
+
+QJsonRpcServicePrivate::ReturnValueEncoder QJsonRpcServicePrivate::returnValueEncoder(int type)
+{
+    switch (type) {
+    case QMetaType::Void:
+        return encodeVoid;
+    case QMetaType::Bool:
+        return encodeDirect<bool>;
+    case QMetaType::Int:
+        return encodeDirect<int>;
+    case QMetaType::UInt:
+        return encodeUInt;
+    case QMetaType::LongLong:
+        return encodeDirect<qint64>;
+    case QMetaType::ULongLong:
+        return encodeULongLong;
+    case QMetaType::Double:
+        return encodeDirect<double>;
+    case QMetaType::Float:
+        return encodeFloat;
+    case QMetaType::QString:
+        return encodeDirect<QString>;
+    case QMetaType::QStringList:
+        return encodeStringList;
+    case QMetaType::QVariantList:
+        return encodeVariantList;
+    case QMetaType::QVariantMap:
+        return encodeVariantMap;
+    case QMetaType::QJsonValue:
+        return encodeDirect<QJsonValue>;
+    case QMetaType::QJsonObject:
+        return encodeDirect<QJsonObject>;
+    case QMetaType::QJsonArray:
+        return encodeDirect<QJsonArray>;
+    default:
+        break;
+    }
+
+    // QVariant and QByteArray results are handled by createResponse()
+    return encodeGeneric;
+}
+
+namespace {
+struct FutureResponderRegistry
+{
+    QMutex lock;
+    QHash<int, QJsonRpc::FutureResponder> responders;
+};
+}
+
+static FutureResponderRegistry &futureResponderRegistry()
+{
+    static FutureResponderRegistry registry;
+    return registry;
+}
+
+void QJsonRpc::registerFutureResponder(int type, FutureResponder responder)
+{
+    FutureResponderRegistry &registry = futureResponderRegistry();
+    QMutexLocker locker(&registry.lock);
+    registry.responders.insert(type, responder);
+}
+
+QJsonRpc::FutureResponder QJsonRpcServicePrivate::futureResponder(int type)
+{
+    FutureResponderRegistry &registry = futureResponderRegistry();
+    QMutexLocker locker(&registry.lock);
+    return registry.responders.value(type, 0);
+}
+
+QJsonRpcMessage QJsonRpcServicePrivate::createResponse(const QJsonRpcMessage &request,
+                                                       QVariant &returnValue)
+{
+    QVariant value = returnValue;
+    if (value.userType() == qMetaTypeId<QJSValue>())
+        value = value.value<QJSValue>().toVariant();    // ArrayBuffer converts to QByteArray
+
+    // other transports get the data as a string, as they always did
+    if (value.userType() == QMetaType::QByteArray && request.acceptsAttachments()) {
+        QJsonRpcMessage response = request.createResponse(QJsonRpcMessage::attachmentReference(0));
+        response.setAttachments(QList<QByteArray>() << value.toByteArray());
+        return response;
+    }
+
+    return request.createResponse(convertReturnValue(returnValue));
+}
+
+// the method name followed by what overload matching looks at: the type of
+// each positional argument, or the sorted keys of named ones with their types
+QByteArray QJsonRpcServicePrivate::parameterShape(const QByteArray &method, const QJsonValue &params)
+{
+    QByteArray shape = method;
+    shape += '(';
+    if (params.isObject()) {
+        const QJsonObject object = params.toObject();
+        for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+            // length prefixed so keys can't run into each other
+            const QByteArray key = it.key().toUtf8();
+            shape += QByteArray::number(key.size());
+            shape += ':';
+            shape += key;
+            shape += char('0' + it.value().type());
+        }
+        shape += '}';
+    } else {
+        const QJsonArray array = params.toArray();
+        for (QJsonArray::const_iterator it = array.constBegin(); it != array.constEnd(); ++it)
+            shape += char('0' + (*it).type());
+    }
+
+    return shape;
+}
+
 static inline QByteArray methodName(const QJsonRpcMessage &request)
 {
     const QString &methodPath(request.method());
@@ -383,101 +1082,470 @@ QJsonRpcMessage QJsonRpcService::dispatch(const QJsonRpcMessage &request)
     Q_D(QJsonRpcService);
     if (request.type() != QJsonRpcMessage::Request &&
         request.type() != QJsonRpcMessage::Notification) {
-        return request.createErrorResponse(QJsonRpc::InvalidRequest, QStringLiteral("invalid request"));
+        return request.createStandardErrorResponse(QJsonRpc::InvalidRequest);
     }
 
-    const QByteArray &method(methodName(request));
-    if (!d->invokableMethodHash.contains(method)) {
-        return request.createErrorResponse(QJsonRpc::MethodNotFound, QStringLiteral("invalid method called"));
+    const QByteArray method(methodName(request));
+    return d->dispatch(request, method, d->methodTable()->findGroup(method));
+}
+
+namespace {
+// the arguments of one call, constructed in place in the layout computed for the method
+class ArgumentStorage
+{
+public:
+    explicit ArgumentStorage(const QJsonRpcServicePrivate::MethodInfo &info)
+        : m_info(info),
+          m_storage((info.argumentStorageSize + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)),
+          m_constructed(0),
+          m_returnValue(nullptr)
+    {
     }
 
-    int idx = -1;
-    QVariantList arguments;
-    const QList<int> &indexes = d->invokableMethodHash.value(method);
-    const QJsonValue &params = request.params();
-    QList<QVariant> parameters;
-    QVariant returnValue;
-    QMetaType::Type returnType = QMetaType::Void;
-
-    bool usingNamedParameters = params.isObject();
-    for (const int methodIndex : indexes) {
-        const QJsonRpcServicePrivate::MethodInfo &info = std::as_const(d->methodInfoHash)[methodIndex];
-        bool methodMatch = usingNamedParameters ?
-            jsParameterCompare(params.toObject(), info) :
-            jsParameterCompare(params.toArray(), info);
-
-        if (methodMatch) {
-            idx = methodIndex;
-            arguments.reserve(info.parameters.size());
-            returnType = static_cast<QMetaType::Type>(info.returnType);
+    ~ArgumentStorage()
+    {
+        if (m_returnValue) {
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-            returnValue = (returnType == QMetaType::Void) ?
-                QVariant() : QVariant(QMetaType(returnType), nullptr);
+            QMetaType(m_info.returnType).destruct(m_returnValue);
 #else
-            returnValue = (returnType == QMetaType::Void) ?
-                QVariant() : QVariant(returnType, nullptr);
+            QMetaType::destruct(m_info.returnType, m_returnValue);
 #endif
-            parameters.reserve(info.parameters.size());
-
-            for (int i = 0; i < info.parameters.size(); ++i) {
-                const QJsonRpcServicePrivate::ParameterInfo &parameterInfo = info.parameters.at(i);
-                QJsonValue incomingArgument = usingNamedParameters ?
-                    params.toObject().value(parameterInfo.name) :
-                    params.toArray().at(i);
-
-                QVariant argument = convertArgument(incomingArgument, parameterInfo);
-                if (!argument.isValid()) {
-                    QString message = incomingArgument.isUndefined() ?
-                        QStringLiteral("failed to construct default object for '%1'").arg(parameterInfo.name) :
-                        QStringLiteral("failed to convert from JSON for '%1'").arg(parameterInfo.name);
-                    return request.createErrorResponse(QJsonRpc::InvalidParams, message);
-                }
+        }
 
-                parameters.append( argument );
-            }
+        while (m_constructed > 0) {
+            --m_constructed;
+            const int type = m_info.parameters.at(m_constructed).type;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+            QMetaType(type).destruct(at(m_constructed));
+#else
+            QMetaType::destruct(type, at(m_constructed));
+#endif
+        }
+    }
 
-            // found a match
-            break;
+    // arguments have to be constructed in order
+    void *construct(int index)
+    {
+        Q_ASSERT(index == m_constructed);
+        const int type = m_info.parameters.at(index).type;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        void *argument = QMetaType(type).construct(at(index));
+#else
+        void *argument = QMetaType::construct(type, at(index), nullptr);
+#endif
+        if (argument)
+            ++m_constructed;
+        return argument;
+    }
+
+    // null for void methods
+    void *constructReturnValue()
+    {
+        if (m_info.returnType == QMetaType::Void)
+            return nullptr;
+
+        void *where = reinterpret_cast<char *>(m_storage.data()) + m_info.returnValueOffset;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        m_returnValue = QMetaType(m_info.returnType).construct(where);
+#else
+        m_returnValue = QMetaType::construct(m_info.returnType, where, nullptr);
+#endif
+        return m_returnValue;
+    }
+
+private:
+    void *at(int index)
+    {
+        return reinterpret_cast<char *>(m_storage.data()) + m_info.parameters.at(index).offset;
+    }
+
+    const QJsonRpcServicePrivate::MethodInfo &m_info;
+    QVarLengthArray<std::max_align_t, 16> m_storage;
+    int m_constructed;
+    void *m_returnValue;
+};
+}
+
+namespace {
+// the socket of a call on the thread pool as seen from there: it lives on the
+// thread that received the request and is the only one to touch the real socket,
+// which may go away at any time. It stays alive until the call is answered.
+class JobReply : public QJsonRpcAbstractSocket
+{
+public:
+    explicit JobReply(QJsonRpcAbstractSocket *target)
+        : m_target(target),
+          m_finished(false)
+    {
+    }
+
+    void notify(const QJsonRpcMessage &response) override
+    {
+        if (m_finished)
+            return;
+
+        m_finished = true;
+        if (m_target)
+            m_target->notify(response);
+        deleteLater();
+    }
+
+private:
+    QPointer<QJsonRpcAbstractSocket> m_target;
+    bool m_finished;
+};
+
+// one call of a service on its thread pool
+class DispatchJob : public QRunnable
+{
+public:
+    DispatchJob(QJsonRpcServicePrivate *service, const QJsonRpcMessage &request,
+                const QByteArray &method, int group, JobReply *reply, QJsonRpcAbstractSocket *peer)
+        : m_service(service),
+          m_request(request),
+          m_method(method),
+          m_group(group),
+          m_reply(reply),
+          m_peer(peer)
+    {
+    }
+
+    void run() override
+    {
+        // the slot sees the socket the request came from, the reply only carries the response
+        const QJsonRpcMessage response = m_service->dispatch(m_request, m_method, m_group, m_reply,
+                                                             m_peer.data());
+        if (response.isValid()) {
+            QMetaObject::invokeMethod(m_reply, "notify", Qt::QueuedConnection,
+                                      Q_ARG(QJsonRpcMessage, response));
+        } else if (m_request.type() != QJsonRpcMessage::Request) {
+            m_reply->deleteLater();
+        }
+        // otherwise a delayed or future response still goes through the reply
+
+        m_service->finishJob();
+    }
+
+private:
+    QJsonRpcServicePrivate *m_service;
+    QJsonRpcMessage m_request;
+    QByteArray m_method;
+    int m_group;
+    JobReply *m_reply;
+    QPointer<QJsonRpcAbstractSocket> m_peer;
+};
+}
+
+void QJsonRpcServicePrivate::dispatchConcurrently(const QJsonRpcMessage &request, const QByteArray &method,
+                                                  int group, QJsonRpcAbstractSocket *socket,
+                                                  QJsonRpcAbstractSocket *peer)
+{
+    {
+        QMutexLocker locker(&jobLock);
+        ++activeJobs;
+    }
+
+    threadPool->start(new DispatchJob(this, request, method, group, new JobReply(socket),
+                                      peer ? peer : socket));
+}
+
+void QJsonRpcServicePrivate::finishJob()
+{
+    QMutexLocker locker(&jobLock);
+    if (--activeJobs == 0)
+        jobsFinished.wakeAll();
+}
+
+QJsonRpcMessage QJsonRpcServicePrivate::dispatchTyped(const QJsonRpcMessage &request,
+                                                      const TypedMethod &method,
+                                                      const RequestContext &context)
+{
+    // same binding rules as for slots: trailing positional arguments may be
+    // left out, named ones all have to be there
+    const QJsonValue &params = request.params();
+    QVarLengthArray<QJsonValue, 8> arguments(method.argumentCount);
+    std::fill(arguments.begin(), arguments.end(), QJsonValue(QJsonValue::Undefined));
+    if (params.isObject()) {
+        const QJsonObject namedParameters = params.toObject();
+        if (method.parameterNames.size() != method.argumentCount && !namedParameters.isEmpty())
+            return request.createStandardErrorResponse(QJsonRpc::InvalidParams);
+
+        for (QJsonObject::const_iterator it = namedParameters.constBegin();
+             it != namedParameters.constEnd(); ++it) {
+            QHash<QString, int>::const_iterator slot = method.parameterIndexes.constFind(it.key());
+            if (slot != method.parameterIndexes.constEnd())
+                arguments[slot.value()] = it.value();
         }
+
+        for (int i = 0; i < arguments.size(); ++i) {
+            if (arguments.at(i).isUndefined())
+                return request.createStandardErrorResponse(QJsonRpc::InvalidParams);
+        }
+    } else {
+        const QJsonArray positionalParameters = params.toArray();
+        if (positionalParameters.size() > method.argumentCount)
+            return request.createStandardErrorResponse(QJsonRpc::InvalidParams);
+        for (int i = 0; i < positionalParameters.size(); ++i)
+            arguments[i] = positionalParameters.at(i);
     }
 
-    if (idx == -1) {
-        return request.createErrorResponse(QJsonRpc::InvalidParams, QStringLiteral("invalid parameters"));
+    QJsonValue result;
+    int failedArgument = -1;
+    if (!method.invoke(arguments.constData(), &result, &failedArgument)) {
+        const QString name = failedArgument >= 0 && failedArgument < method.parameterNames.size() ?
+            method.parameterNames.at(failedArgument) : QString::number(failedArgument);
+        QString message = QStringLiteral("failed to convert from JSON for '%1'").arg(name);
+        return request.createErrorResponse(QJsonRpc::InvalidParams, message);
     }
 
-    QJsonRpcServicePrivate::MethodInfo &info = d->methodInfoHash[idx];
+    if (context.delayed)
+        return QJsonRpcMessage();
 
-#define PASS_ARG(index) index < parameters.count() ? QGenericArgument("QVariant", &parameters[index]) : QGenericArgument()
+    return request.createResponse(result);
+}
+
+QJsonRpcServicePrivate::ResultCache::ResultCache(int t, int maxEntries)
+    : entries(maxEntries),
+      ttl(t),
+      hits(0),
+      misses(0)
+{
+}
 
-    bool success = QMetaObject::invokeMethod( this, method.constData(), QGenericReturnArgument("QVariant", &returnValue),
-                                              PASS_ARG(0),
-                                              PASS_ARG(1),
-                                              PASS_ARG(2),
-                                              PASS_ARG(3),
-                                              PASS_ARG(4),
-                                              PASS_ARG(5),
-                                              PASS_ARG(6),
-                                              PASS_ARG(7),
-                                              PASS_ARG(8),
-                                              PASS_ARG(9) );
+// objects are written with their keys sorted, equal parameters give equal keys
+QByteArray QJsonRpcServicePrivate::canonicalParameters(const QJsonValue &params)
+{
+    if (params.isObject())
+        return QJsonDocument(params.toObject()).toJson(QJsonDocument::Compact);
+    if (params.isArray())
+        return QJsonDocument(params.toArray()).toJson(QJsonDocument::Compact);
+    return QByteArray();
+}
+
+void QJsonRpcServicePrivate::setResultCaching(const QByteArray &method, int ttl, int maxEntries)
+{
+    QMutexLocker locker(&resultCacheLock);
+    if (maxEntries <= 0) {
+        resultCaches.remove(method);
+        return;
+    }
+
+    resultCaches.insert(method, QSharedPointer<ResultCache>::create(ttl, maxEntries));
+}
+
+QJsonRpcServiceRequest QJsonRpcServicePrivate::serviceRequest(const QJsonRpcMessage &request,
+                                                              QJsonRpcAbstractSocket *socket,
+                                                              QJsonRpcAbstractSocket *peer)
+{
+    QJsonRpcServiceRequest serviceRequest(request, socket);
+    if (peer != socket)
+        serviceRequest.d->peer = peer;
+    return serviceRequest;
+}
+
+QJsonRpcMessage QJsonRpcServicePrivate::dispatch(const QJsonRpcMessage &request,
+                                                 const QByteArray &method, int group,
+                                                 QJsonRpcAbstractSocket *socket,
+                                                 QJsonRpcAbstractSocket *peer)
+{
+    QSharedPointer<ResultCache> cache;
+    if (request.type() == QJsonRpcMessage::Request) {
+        QMutexLocker locker(&resultCacheLock);
+        if (!resultCaches.isEmpty())
+            cache = resultCaches.value(method);
+    }
+
+    if (!cache)
+        return invoke(request, method, group, socket, peer);
+
+    // byte array results differ between transports, see createResponse()
+    QByteArray key = request.acceptsAttachments() ? "@" : "";
+    key += canonicalParameters(request.params());
+    {
+        QMutexLocker locker(&resultCacheLock);
+        ResultCache::Entry *entry = cache->entries.object(key);
+        if (entry && (entry->expiry < 0 || entry->expiry > resultCacheClock.elapsed())) {
+            ++cache->hits;
+            return request.createResponse(entry->result);
+        }
+
+        if (entry)
+            cache->entries.remove(key);
+        ++cache->misses;
+    }
+
+    // only plain results are kept, errors and delayed responses are not
+    const QJsonRpcMessage response = invoke(request, method, group, socket, peer);
+    if (response.type() == QJsonRpcMessage::Response && response.attachments().isEmpty()) {
+        ResultCache::Entry *entry = new ResultCache::Entry;
+        entry->result = response.result();
+        entry->expiry = cache->ttl < 0 ? -1 : resultCacheClock.elapsed() + cache->ttl;
+        QMutexLocker locker(&resultCacheLock);
+        cache->entries.insert(key, entry);
+    }
+
+    return response;
+}
+
+QJsonRpcMessage QJsonRpcServicePrivate::invoke(const QJsonRpcMessage &request,
+                                               const QByteArray &method, int group,
+                                               QJsonRpcAbstractSocket *socket,
+                                               QJsonRpcAbstractSocket *peer)
+{
+    Q_Q(QJsonRpcService);
+    RequestContext context(this, request, socket, peer ? peer : socket);
+    const QSharedPointer<const TypedMethod> handler = typedMethodTable().value(method);
+    if (handler)
+        return dispatchTyped(request, *handler, context);
+
+    // keeps the tables alive should the slot re-register the service
+    const QSharedPointer<const Metadata> methods = methodTable();
+    if (group < 0 || group >= methods->groups.size())
+        return request.createStandardErrorResponse(QJsonRpc::MethodNotFound);
+
+    const QJsonValue &params = request.params();
+    const bool usingNamedParameters = params.isObject();
+    const QJsonObject namedParameters = usingNamedParameters ? params.toObject() : QJsonObject();
+    const QJsonArray positionalParameters = usingNamedParameters ? QJsonArray() : params.toArray();
+
+    // calls with the same argument shape always pick the same overload
+    const QByteArray shape = parameterShape(method, params);
+    int idx = -1;
+    bool cached = false;
+    {
+        QMutexLocker locker(&overloadCacheLock);
+        QHash<QByteArray, int>::const_iterator it = overloadCache.constFind(shape);
+        if (it != overloadCache.constEnd()) {
+            idx = it.value();
+            cached = true;
+        }
+    }
+
+    if (!cached) {
+        const MethodGroup &overloads = methods->groups.at(group);
+        for (int i = overloads.first; i < overloads.first + overloads.count; ++i) {
+            const QJsonRpcServicePrivate::MethodInfo &info = methods->methods.at(i);
+            bool methodMatch = usingNamedParameters ?
+                jsParameterCompare(namedParameters, info) :
+                jsParameterCompare(positionalParameters, info);
+            if (methodMatch) {
+                idx = i;
+                break;
+            }
+        }
+
+        QMutexLocker locker(&overloadCacheLock);
+        if (overloadCache.size() >= MaximumCachedOverloads)
+            overloadCache.clear();
+        overloadCache.insert(shape, idx);
+    }
+
+    if (idx == -1 || idx >= methods->methods.size()) {
+        return request.createStandardErrorResponse(QJsonRpc::InvalidParams);
+    }
+
+    const QJsonRpcServicePrivate::MethodInfo &info = methods->methods.at(idx);
+
+    // bind the incoming values to parameter slots, named ones in a single walk
+    // over the object, missing ones stay undefined and are default constructed
+    QVarLengthArray<QJsonValue, 8> incomingArguments(info.parameters.size());
+    std::fill(incomingArguments.begin(), incomingArguments.end(), QJsonValue(QJsonValue::Undefined));
+    if (usingNamedParameters) {
+        for (QJsonObject::const_iterator it = namedParameters.constBegin();
+             it != namedParameters.constEnd(); ++it) {
+            QHash<QString, int>::const_iterator slot = info.parameterIndexes.constFind(it.key());
+            if (slot != info.parameterIndexes.constEnd())
+                incomingArguments[slot.value()] = it.value();
+        }
+    } else {
+        const int count = qMin(int(incomingArguments.size()), int(positionalParameters.size()));
+        for (int i = 0; i < count; ++i)
+            incomingArguments[i] = positionalParameters.at(i);
+    }
+
+    // arguments are constructed in place and converted with the converter
+    // picked for their type, QVariant parameters are passed as themselves
+    ArgumentStorage arguments(info);
+    QVarLengthArray<void *, 11> argv(info.parameters.size() + 1);
+    const QList<QByteArray> attachments = request.attachments();
+    for (int i = 0; i < info.parameters.size(); ++i) {
+        const QJsonRpcServicePrivate::ParameterInfo &parameterInfo = info.parameters.at(i);
+        void *argument = arguments.construct(i);
+        if (!argument) {
+            QString message =
+                QStringLiteral("failed to construct default object for '%1'").arg(parameterInfo.name);
+            return request.createErrorResponse(QJsonRpc::InvalidParams, message);
+        }
+        argv[i + 1] = argument;
+
+        const QJsonValue &incomingArgument = incomingArguments.at(i);
+        if (incomingArgument.isUndefined())
+            continue;
+
+        // attachments are handed over as is, without going through JSON
+        bool converted = false;
+        const int attachment = QJsonRpcMessage::attachmentIndex(incomingArgument);
+        if (attachment >= 0 && attachment < attachments.size() &&
+            parameterInfo.type == QMetaType::QByteArray) {
+            *static_cast<QByteArray *>(argument) = attachments.at(attachment);
+            converted = true;
+        } else if (attachment >= 0 && attachment < attachments.size() &&
+                   parameterInfo.type == QMetaType::QVariant) {
+            *static_cast<QVariant *>(argument) = QVariant(attachments.at(attachment));
+            converted = true;
+        } else {
+            converted = parameterInfo.convert(incomingArgument, parameterInfo, argument);
+        }
+
+        if (!converted) {
+            QString message =
+                QStringLiteral("failed to convert from JSON for '%1'").arg(parameterInfo.name);
+            return request.createErrorResponse(QJsonRpc::InvalidParams, message);
+        }
+    }
+
+    // call the resolved method by index, the slot writes its result straight
+    // into typed storage which the method's encoder turns into JSON
+    argv[0] = arguments.constructReturnValue();
+    if (!argv[0] && info.returnType != QMetaType::Void) {
+        QString message = QStringLiteral("failed to construct return value for '%1'").arg(QString::fromUtf8(method));
+        return request.createErrorResponse(QJsonRpc::InternalError, message);
+    }
+
+    bool success = QMetaObject::metacall(q, QMetaObject::InvokeMetaMethod, info.index, argv.data()) < 0;
     if (!success) {
         QString message = QStringLiteral("dispatch for method '%1' failed").arg(QString::fromUtf8(method));
         return request.createErrorResponse(QJsonRpc::InvalidRequest, message);
     }
 
-    if (d->delayedResponse) {
-        d->delayedResponse = false;
+    if (context.delayed)
+        return QJsonRpcMessage();
+
+    // the future's watcher sends the response once it has a result
+    if (info.respondToFuture) {
+        if (request.type() == QJsonRpcMessage::Request) {
+            QThread *thread = socket ? socket->thread() : q->thread();
+            info.respondToFuture(argv[0], serviceRequest(request, socket, context.peer), thread);
+        }
         return QJsonRpcMessage();
     }
 
+    if (info.returnType == QMetaType::QVariant)
+        return QJsonRpcServicePrivate::createResponse(request, *static_cast<QVariant *>(argv[0]));
+    if (info.returnType == QMetaType::QByteArray) {
+        QVariant returnValue(*static_cast<const QByteArray *>(argv[0]));
+        return QJsonRpcServicePrivate::createResponse(request, returnValue);
+    }
+
+    const QJsonValue result = info.encodeReturnValue(info.returnType, argv[0]);
     if (info.hasOut) {
         QJsonArray ret;
         if (info.returnType != QMetaType::Void)
-            ret.append(QJsonRpcServicePrivate::convertReturnValue(returnValue));
+            ret.append(result);
         if (ret.size() > 1)
             return request.createResponse(ret);
         return request.createResponse(ret.first());
     }
 
-    return request.createResponse(QJsonRpcServicePrivate::convertReturnValue(returnValue));
+    return request.createResponse(result);
 }
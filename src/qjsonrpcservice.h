@@ -19,9 +19,93 @@
 
 #include <QVariant>
 #include <QPointer>
+#include <QStringList>
+
+#include <functional>
+#include <tuple>
 
 #include "qjsonrpcmessage.h"
 
+namespace QJsonRpc {
+    // decodes the arguments of a typed method, missing ones are undefined and
+    // stay default constructed, sets failedArgument when one doesn't convert
+    typedef std::function<bool (const QJsonValue *arguments, QJsonValue *result,
+                                int *failedArgument)> MethodInvoker;
+
+    template <int...> struct IndexList {};
+    template <int N, int... I> struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+    template <int... I> struct MakeIndexList<0, I...> { typedef IndexList<I...> Type; };
+
+    // signature of anything callable that isn't overloaded or a template
+    template <typename Function>
+    struct FunctionTraits : FunctionTraits<decltype(&Function::operator())> {};
+
+    template <typename Return, typename... Args>
+    struct FunctionTraits<Return (*)(Args...)>
+    {
+        typedef Return ReturnType;
+        typedef std::tuple<typename std::decay<Args>::type...> Arguments;
+        enum { ArgumentCount = sizeof...(Args) };
+    };
+
+    template <typename Return, typename Class, typename... Args>
+    struct FunctionTraits<Return (Class::*)(Args...)> : FunctionTraits<Return (*)(Args...)> {};
+    template <typename Return, typename Class, typename... Args>
+    struct FunctionTraits<Return (Class::*)(Args...) const> : FunctionTraits<Return (*)(Args...)> {};
+
+    template <typename T>
+    inline bool decodeArgument(const QJsonValue &value, T *argument, int index, int *failedArgument)
+    {
+        if (value.isUndefined() || fromJsonValue(value, argument))
+            return true;
+        *failedArgument = index;
+        return false;
+    }
+
+    template <typename Return>
+    struct ResultEncoder
+    {
+        template <typename Function, typename... Args>
+        static QJsonValue call(Function &function, Args &... args)
+        { return toJsonValue<typename std::decay<Return>::type>(function(args...)); }
+    };
+
+    template <>
+    struct ResultEncoder<void>
+    {
+        template <typename Function, typename... Args>
+        static QJsonValue call(Function &function, Args &... args)
+        { function(args...); return QJsonValue(); }
+    };
+
+    template <typename Function, typename Arguments, typename Indexes>
+    struct TypedInvoker;
+
+    template <typename Function, typename... Args, int... I>
+    struct TypedInvoker<Function, std::tuple<Args...>, IndexList<I...> >
+    {
+        explicit TypedInvoker(const Function &f) : function(f) {}
+
+        bool operator()(const QJsonValue *arguments, QJsonValue *result, int *failedArgument)
+        {
+            std::tuple<Args...> values;
+            bool decoded = true;
+            const int expand[] = { 0, (decoded = decoded &&
+                decodeArgument(arguments[I], &std::get<I>(values), I, failedArgument), 0)... };
+            Q_UNUSED(expand)
+            Q_UNUSED(arguments)
+            if (!decoded)
+                return false;
+
+            typedef typename FunctionTraits<Function>::ReturnType Return;
+            *result = ResultEncoder<Return>::call(function, std::get<I>(values)...);
+            return true;
+        }
+
+        Function function;
+    };
+}
+
 class QJsonRpcAbstractSocket;
 class QJsonRpcServiceRequestPrivate;
 class QJSONRPC_EXPORT QJsonRpcServiceRequest
@@ -35,6 +119,7 @@ public:
 
     bool isValid() const;
     QJsonRpcMessage request() const;
+    // the socket the request arrived on, the response may take another way
     QJsonRpcAbstractSocket *socket() const;
 
     bool respond(const QJsonRpcMessage &response);
@@ -42,8 +127,10 @@ public:
 
 private:
     QSharedDataPointer<QJsonRpcServiceRequestPrivate> d;
+    friend class QJsonRpcServicePrivate;
 };
 
+class QThreadPool;
 class QJsonRpcServiceProvider;
 class QJsonRpcServicePrivate;
 class QJSONRPC_EXPORT QJsonRpcService : public QObject
@@ -53,12 +140,83 @@ public:
     explicit QJsonRpcService(QObject *parent = 0);
     ~QJsonRpcService();
 
+    // adds a method backed by a callable instead of a slot, its arguments and
+    // result are converted by QJsonRpc::JsonValueConverter without a QVariant in
+    // between. Named parameters are accepted when parameterNames are given.
+    // Registered methods take precedence over slots of the same name.
+    template <typename Function>
+    bool registerMethod(const QByteArray &name, Function function,
+                        const QStringList &parameterNames = QStringList())
+    {
+        typedef QJsonRpc::FunctionTraits<Function> Traits;
+        typedef QJsonRpc::TypedInvoker<Function, typename Traits::Arguments,
+            typename QJsonRpc::MakeIndexList<Traits::ArgumentCount>::Type> Invoker;
+        return registerInvoker(name, Traits::ArgumentCount, parameterNames, Invoker(function));
+    }
+
+    // the object has to outlive the registration
+    template <typename Class, typename Return, typename... Args>
+    bool registerMethod(const QByteArray &name, Class *object, Return (Class::*method)(Args...),
+                        const QStringList &parameterNames = QStringList())
+    {
+        return registerMethod(name, [object, method](Args... args) -> Return {
+            return (object->*method)(args...);
+        }, parameterNames);
+    }
+
+    template <typename Class, typename Return, typename... Args>
+    bool registerMethod(const QByteArray &name, const Class *object,
+                        Return (Class::*method)(Args...) const,
+                        const QStringList &parameterNames = QStringList())
+    {
+        return registerMethod(name, [object, method](Args... args) -> Return {
+            return (object->*method)(args...);
+        }, parameterNames);
+    }
+
+    bool unregisterMethod(const QByteArray &name);
+
+    // calls arriving through a server run on this pool instead of the server
+    // thread, responses may then be sent in a different order than requests
+    // came in. Q_CLASSINFO("concurrency", "threadpool") selects the global pool.
+    void setThreadPool(QThreadPool *pool);
+    QThreadPool *threadPool() const;
+    // blocks until the calls queued or running on the thread pool are done.
+    // QJsonRpcServiceProvider does so when the service is removed and before it
+    // deletes the services it owns, a service still registered elsewhere has to
+    // be removed before it is deleted.
+    void waitForJobs();
+
+    // reuses the results of a side effect free method for requests with equal
+    // parameters, for ttl msecs (-1 for no expiry) and up to maxEntries, the
+    // least recently used ones go first. Q_CLASSINFO("cache.<method>",
+    // "<ttl>[,<maxEntries>]") does the same, maxEntries 0 disables caching.
+    void setResultCaching(const QByteArray &method, int ttl, int maxEntries = 1024);
+    // all methods for an empty name
+    void invalidateCachedResults(const QByteArray &method = QByteArray());
+
+    struct CacheStatistics
+    {
+        quint64 hits;
+        quint64 misses;
+        int entries;
+    };
+    CacheStatistics cacheStatistics(const QByteArray &method) const;
+
+    // requests arriving through a server while an identical one is still being
+    // answered share its response instead of calling the method again, each
+    // under its own id. Q_CLASSINFO("singleflight", "<method>[,<method>...]")
+    void setSingleFlight(const QByteArray &method, bool enabled = true);
+    bool isSingleFlight(const QByteArray &method) const;
+
 Q_SIGNALS:
     void result(const QJsonRpcMessage &result);
     void notifyConnectedClients(const QJsonRpcMessage &message);
     void notifyConnectedClients(const QString &method, const QJsonArray &params = QJsonArray());
 
 protected:
+    // the request of the call being dispatched to the calling slot, valid only
+    // while it runs. Keep a copy and call beginDelayedResponse() to respond later.
     QJsonRpcServiceRequest currentRequest() const;
     void beginDelayedResponse();
 
@@ -66,9 +224,13 @@ protected Q_SLOTS:
     QJsonRpcMessage dispatch(const QJsonRpcMessage &request);
 
 private:
+    bool registerInvoker(const QByteArray &name, int argumentCount,
+                         const QStringList &parameterNames, const QJsonRpc::MethodInvoker &invoker);
+
     Q_DISABLE_COPY(QJsonRpcService)
     Q_DECLARE_PRIVATE(QJsonRpcService)
     friend class QJsonRpcServiceProvider;
+    friend class QJsonRpcServiceProviderPrivate;
 
 #if !defined(USE_QT_PRIVATE_HEADERS)
     QScopedPointer<QJsonRpcServicePrivate> d_ptr;
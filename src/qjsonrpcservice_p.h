@@ -18,22 +18,47 @@
 #ifndef QJSONRPCSERVICE_P_H
 #define QJSONRPCSERVICE_P_H
 
+#include <QCache>
+#include <QElapsedTimer>
 #include <QHash>
+#include <QMutex>
 #include <QPointer>
+#include <QSet>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QVarLengthArray>
 #include <QStringList>
+#include <QSharedPointer>
+#include <QVector>
 
+#include "qjsonrpcobjectpool_p.h"
+#include "qjsonrpcmetatype.h"
 #include "qjsonrpcservice.h"
 
 class QJsonRpcAbstractSocket;
 class QJsonRpcServiceRequestPrivate : public QSharedData
 {
 public:
+    QJSONRPC_DECLARE_POOLED_ALLOCATOR
+
     QJsonRpcMessage request;
-    QPointer<QJsonRpcAbstractSocket> socket;
+    QPointer<QJsonRpcAbstractSocket> socket;   // the response goes here
+    QPointer<QJsonRpcAbstractSocket> peer;     // the request came from here, if another
 };
 
 class QJsonRpcService;
+
+// a method string resolved to its service and overload group, interned by the
+// provider so repeated calls skip splitting and re-encoding the method path
+struct QJsonRpcMethodHandle
+{
+    QJsonRpcMethodHandle() : service(0), group(-1) {}
+
+    QJsonRpcService *service;
+    QByteArray name;
+    int group;
+};
+
 #if defined(USE_QT_PRIVATE_HEADERS)
 #include <private/qobject_p.h>
 
@@ -44,15 +69,47 @@ class QJsonRpcServicePrivate
 {
 public:
     QJsonRpcServicePrivate(QJsonRpcService *parent)
-        : delayedResponse(false),
+        : metadata(new Metadata),
+          threadPoolSet(false),
+          activeJobs(0),
           q_ptr(parent)
     {
+        resultCacheClock.start();
     }
 
     void cacheInvokableInfo();
+    // serves cached results, invoke() does the actual call. The response goes
+    // to socket, peer is the socket the request came from when that is a
+    // stand-in, QJsonRpcServiceRequest::socket() still reports the peer.
+    QJsonRpcMessage dispatch(const QJsonRpcMessage &request, const QByteArray &method, int group,
+                             QJsonRpcAbstractSocket *socket = 0, QJsonRpcAbstractSocket *peer = 0);
+    QJsonRpcMessage invoke(const QJsonRpcMessage &request, const QByteArray &method, int group,
+                           QJsonRpcAbstractSocket *socket, QJsonRpcAbstractSocket *peer);
+    // runs dispatch() on the thread pool, the response is sent from the socket's thread
+    void dispatchConcurrently(const QJsonRpcMessage &request, const QByteArray &method, int group,
+                              QJsonRpcAbstractSocket *socket, QJsonRpcAbstractSocket *peer = 0);
+    static QJsonRpcServiceRequest serviceRequest(const QJsonRpcMessage &request,
+                                                 QJsonRpcAbstractSocket *socket,
+                                                 QJsonRpcAbstractSocket *peer);
+    void finishJob();
     static int qjsonRpcMessageType;
     static int convertVariantTypeToJSType(int type);
     static QJsonValue convertReturnValue(QVariant &returnValue);
+    // QByteArray results travel as an attachment when the request came over a
+    // framed transport, elsewhere they are converted as before
+    static QJsonRpcMessage createResponse(const QJsonRpcMessage &request, QVariant &returnValue);
+    static QByteArray parameterShape(const QByteArray &method, const QJsonValue &params);
+
+    struct ParameterInfo;
+    // assigns a JSON value to a default constructed argument of the parameter type
+    typedef bool (*ArgumentConverter)(const QJsonValue &value, const ParameterInfo &info,
+                                      void *argument);
+    static ArgumentConverter argumentConverter(int type);
+    // turns the value a slot returned into its JSON result
+    typedef QJsonValue (*ReturnValueEncoder)(int type, const void *value);
+    static ReturnValueEncoder returnValueEncoder(int type);
+    // null unless type was registered with qRegisterJsonRpcFutureType()
+    static QJsonRpc::FutureResponder futureResponder(int type);
 
     struct ParameterInfo
     {
@@ -62,23 +119,135 @@ public:
         int jsType;
         QString name;
         bool out;
+        ArgumentConverter convert;
+        int offset;     // into the argument storage of a call
     };
 
     struct MethodInfo
     {
         MethodInfo();
-        MethodInfo(const QMetaMethod &method);
+        MethodInfo(const QMetaMethod &method, int index);
 
-        QVarLengthArray<ParameterInfo> parameters;
+        int index;      // of the method in its meta object
+        QVarLengthArray<ParameterInfo, 4> parameters;
+        QHash<QString, int> parameterIndexes;  // named parameter binding plan
+        int argumentStorageSize;    // arguments followed by the return value
+        int returnValueOffset;
         int returnType;
+        ReturnValueEncoder encodeReturnValue;
+        QJsonRpc::FutureResponder respondToFuture;
         bool valid;
         bool hasOut;
     };
 
-    QHash<int, MethodInfo > methodInfoHash;
-    QHash<QByteArray, QList<int> > invokableMethodHash;
-    QJsonRpcServiceRequest currentRequest;
-    bool delayedResponse;
+    // overloads sharing a name, adjacent in Metadata::methods in the order they are tried
+    struct MethodGroup
+    {
+        QByteArray name;
+        int first;
+        int count;
+    };
+
+    // method tables of a service class, built once per meta object and shared
+    // read-only by all instances of it. Methods are kept in one contiguous
+    // array and names are found through a perfect hash over the groups.
+    struct Metadata
+    {
+        Metadata() : metaData(0), stringData(0) { buildLookup(); }
+
+        int findGroup(const QByteArray &name) const;     // -1 if unknown
+        void buildLookup();
+
+        QVector<MethodInfo> methods;
+        QVector<MethodGroup> groups;
+        QVector<uint> seeds;            // per bucket of the first level hash
+        QVector<int> lookupTable;       // group index per slot, -1 for free slots
+
+        // identify the meta object contents, its address may be reused by
+        // another dynamic meta object once the entry expired
+        const uint *metaData;
+        const void *stringData;
+    };
+    static QSharedPointer<const Metadata> sharedMetadata(const QMetaObject *metaObject, int startIndex);
+
+    QSharedPointer<const Metadata> metadata;
+
+    // a method added through QJsonRpcService::registerMethod()
+    struct TypedMethod
+    {
+        QJsonRpc::MethodInvoker invoke;
+        int argumentCount;
+        QStringList parameterNames;
+        QHash<QString, int> parameterIndexes;
+    };
+    struct RequestContext;
+    QJsonRpcMessage dispatchTyped(const QJsonRpcMessage &request, const TypedMethod &method,
+                                  const RequestContext &context);
+    // shared so a handler can unregister itself while it runs
+    QHash<QByteArray, QSharedPointer<const TypedMethod> > typedMethods;
+
+    // metadata and typedMethods are replaced on the owner thread while calls on
+    // the thread pool look methods up, readers take a copy under methodLock
+    QSharedPointer<const Metadata> methodTable() const;
+    QHash<QByteArray, QSharedPointer<const TypedMethod> > typedMethodTable() const;
+    mutable QMutex methodLock;
+
+    // position in Metadata::methods picked per parameterShape(), -1 when nothing matched
+    enum { MaximumCachedOverloads = 1024 };
+    QHash<QByteArray, int> overloadCache;
+    QMutex overloadCacheLock;
+
+    // results of methods set up for caching, keyed on their canonical parameters
+    struct ResultCache
+    {
+        struct Entry
+        {
+            QJsonValue result;
+            qint64 expiry;      // on resultCacheClock, -1 for never
+        };
+
+        ResultCache(int ttl, int maxEntries);
+
+        QCache<QByteArray, Entry> entries;
+        int ttl;
+        quint64 hits;
+        quint64 misses;
+    };
+    enum { DefaultResultCacheSize = 1024 };
+    static QByteArray canonicalParameters(const QJsonValue &params);
+    void setResultCaching(const QByteArray &method, int ttl, int maxEntries);
+    QHash<QByteArray, QSharedPointer<ResultCache> > resultCaches;
+    mutable QMutex resultCacheLock;
+    QElapsedTimer resultCacheClock;
+
+    QSet<QByteArray> singleFlightMethods;
+    mutable QMutex singleFlightLock;
+
+    QPointer<QThreadPool> threadPool;
+    bool threadPoolSet;             // explicitly, overrides the class info
+    QMutex jobLock;
+    QWaitCondition jobsFinished;
+    int activeJobs;                 // queued or running on the thread pool
+
+    // the call dispatch() is running on the current thread, a stack with
+    // an entry per nested dispatch so any number of calls can be in flight
+    // and each delayed response keeps its own request
+    struct RequestContext
+    {
+        RequestContext(const QJsonRpcServicePrivate *service, const QJsonRpcMessage &request,
+                       QJsonRpcAbstractSocket *socket, QJsonRpcAbstractSocket *peer);
+        ~RequestContext();
+
+        // innermost context of the service on this thread, null outside of dispatch()
+        static RequestContext *find(const QJsonRpcServicePrivate *service);
+
+        const QJsonRpcServicePrivate *service;
+        const QJsonRpcMessage &request;
+        QJsonRpcAbstractSocket *socket;
+        QJsonRpcAbstractSocket *peer;
+        bool delayed;
+        RequestContext *previous;
+    };
 
     QJsonRpcService * const q_ptr;
     Q_DECLARE_PUBLIC(QJsonRpcService)
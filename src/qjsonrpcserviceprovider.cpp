@@ -1,30 +1,447 @@
+#include <algorithm>
+
 #include <QObjectCleanupHandler>
+#include <QStringList>
 #include <QMetaObject>
 #include <QMetaClassInfo>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QThread>
+#include <QTimer>
 #include <QDebug>
 
 #include "qjsonrpcservice.h"
 #include "qjsonrpcservice_p.h"
 #include "qjsonrpcsocket.h"
+#include "qjsonrpcwireformat_p.h"
 #include "qjsonrpcserviceprovider.h"
 
+namespace {
+// stands in for the socket of the first of several identical requests and
+// copies its response to every request that joined while it was in flight
+class SingleFlight : public QJsonRpcAbstractSocket
+{
+public:
+    // a call not answered by then fails for its waiters, identical requests run again
+    enum { MaximumAge = 30000 };
+
+    SingleFlight() : m_finished(false)
+    {
+        m_started.start();
+        // nothing else deletes a flight whose call never answers
+        QTimer::singleShot(MaximumAge, this, [this]() {
+            notify(QJsonRpcMessage().createErrorResponse(QJsonRpc::TimeoutError,
+                                                         QStringLiteral("call did not finish in time")));
+        });
+    }
+
+    bool isJoinable() const { return !m_finished && !m_started.hasExpired(MaximumAge); }
+    void attach(QJsonRpcAbstractSocket *socket, const QJsonRpcMessage &request)
+    {
+        Waiter waiter = { socket, request };
+        m_waiters.append(waiter);
+    }
+
+    void notify(const QJsonRpcMessage &response) override
+    {
+        if (m_finished)
+            return;
+
+        m_finished = true;
+        for (const Waiter &waiter : qAsConst(m_waiters)) {
+            if (!waiter.socket)
+                continue;
+
+            if (response.type() == QJsonRpcMessage::Error) {
+                waiter.socket->notify(waiter.request.createErrorResponse(
+                    static_cast<QJsonRpc::ErrorCode>(response.errorCode()),
+                    response.errorMessage(), response.errorData()));
+            } else {
+                QJsonRpcMessage reply = waiter.request.createResponse(response.result());
+                reply.setAttachments(response.attachments());
+                waiter.socket->notify(reply);
+            }
+        }
+
+        m_waiters.clear();
+        deleteLater();
+    }
+
+private:
+    struct Waiter
+    {
+        QPointer<QJsonRpcAbstractSocket> socket;
+        QJsonRpcMessage request;
+    };
+
+    QList<Waiter> m_waiters;
+    QElapsedTimer m_started;
+    bool m_finished;
+};
+
+// concurrency limits by service or method name, shared with the calls
+// holding them so those can still release after the provider is gone
+class Admission
+{
+public:
+    struct Limit;
+    typedef QSharedPointer<Limit> LimitPointer;
+
+    // a request waiting for or holding its limits
+    struct Call
+    {
+        QPointer<QJsonRpcService> service;
+        QByteArray name;
+        int group;
+        QPointer<QJsonRpcAbstractSocket> socket;
+        QPointer<QJsonRpcAbstractSocket> peer;  // the request came from, socket may stand in
+        QJsonRpcMessage request;
+        QList<LimitPointer> limits;
+        QThread *thread;        // that received the request, the call runs there
+    };
+
+    // held by the calls counted against it, a removed limit is still
+    // released by the calls that were running under it
+    struct Limit
+    {
+        Limit() : maxConcurrent(0), maxQueued(0), inFlight(0) {}
+
+        bool hasCapacity() const { return inFlight < maxConcurrent; }
+
+        int maxConcurrent;
+        int maxQueued;
+        int inFlight;
+        QList<Call> queue;
+    };
+
+    ~Admission();
+
+    // calls whose limits have room again, taken off their queues and counted
+    QList<Call> takeAdmissible();
+    // drops a limit, returns the waiting calls this admitted
+    QList<Call> remove(const QString &name);
+
+    QMutex lock;
+    QHash<QString, LimitPointer> limits;
+};
+
+Admission::~Admission()
+{
+    // queued calls point back at their limits
+    for (const LimitPointer &limit : qAsConst(limits))
+        limit->queue.clear();
+}
+
+static bool hasCapacity(const QList<Admission::LimitPointer> &limits)
+{
+    for (const Admission::LimitPointer &limit : limits) {
+        if (!limit->hasCapacity())
+            return false;
+    }
+
+    return true;
+}
+
+QList<Admission::Call> Admission::takeAdmissible()
+{
+    QList<Call> admitted;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (const LimitPointer &limit : qAsConst(limits)) {
+            while (!limit->queue.isEmpty() && hasCapacity(limit->queue.first().limits)) {
+                const Call call = limit->queue.takeFirst();
+                for (const LimitPointer &held : call.limits)
+                    ++held->inFlight;
+                admitted.append(call);
+                progress = true;
+            }
+        }
+    }
+
+    return admitted;
+}
+
+QList<Admission::Call> Admission::remove(const QString &name)
+{
+    QList<Call> admitted;
+    const LimitPointer removed = limits.take(name);
+    if (!removed)
+        return admitted;
+
+    // its waiting calls go on to the next limit without room or are admitted
+    const QList<Call> queue = removed->queue;
+    removed->queue.clear();
+    for (Call call : queue) {
+        call.limits.removeAll(removed);
+        LimitPointer blocking;
+        for (const LimitPointer &limit : qAsConst(call.limits)) {
+            if (!limit->hasCapacity()) {
+                blocking = limit;
+                break;
+            }
+        }
+
+        if (blocking) {
+            blocking->queue.append(call);
+            continue;
+        }
+
+        for (const LimitPointer &limit : qAsConst(call.limits))
+            ++limit->inFlight;
+        admitted.append(call);
+    }
+
+    return admitted;
+}
+
+// stands in for the socket of a call holding concurrency limits, which are
+// released once the response passes through
+class AdmittedCall : public QJsonRpcAbstractSocket
+{
+public:
+    AdmittedCall(const QSharedPointer<Admission> &admission, const QList<Admission::LimitPointer> &limits,
+                 QJsonRpcAbstractSocket *target)
+        : m_admission(admission),
+          m_limits(limits),
+          m_target(target),
+          m_finished(false)
+    {
+    }
+
+    void notify(const QJsonRpcMessage &response) override;
+
+private:
+    QSharedPointer<Admission> m_admission;
+    QList<Admission::LimitPointer> m_limits;
+    QPointer<QJsonRpcAbstractSocket> m_target;
+    bool m_finished;
+};
+}
+
 class QJsonRpcServiceProviderPrivate
 {
 public:
+    QJsonRpcServiceProviderPrivate()
+        : nextFlightSweep(MinimumFlightSweep),
+          admission(new Admission)
+    {
+    }
+
     QByteArray serviceName(QJsonRpcService *service);
+    // memoized by method string after the envelope is decoded. Messages are
+    // parsed by sockets that don't know the service table, so the handle can't
+    // be attached while parsing. A hit costs one hash of the method string, and
+    // the returned copy only shares the name. Returned by value because a slot
+    // adding or removing a service clears the table while the handle is in use.
+    QJsonRpcMethodHandle resolve(const QString &method);
+    // the socket to dispatch with, null if the request joined one in flight
+    QJsonRpcAbstractSocket *joinFlight(QJsonRpcAbstractSocket *socket, const QJsonRpcMessage &request);
+    // of a removed service, all of them for an empty name
+    void dropFlights(const QByteArray &serviceName);
 
     QHash<QByteArray, QJsonRpcService*> services;
+    QHash<QString, QJsonRpcMethodHandle> methodHandles;
     QObjectCleanupHandler cleanupHandler;
 
+    // identical requests in flight by method and canonical parameters,
+    // finished ones are swept out as the table grows
+    enum { MinimumFlightSweep = 64 };
+    QHash<QByteArray, QPointer<SingleFlight> > flights;
+    int nextFlightSweep;
+
+    // the response goes to socket, the slot sees peer as the socket of its request
+    static void dispatch(QJsonRpcService *service, const QByteArray &name, int group,
+                         QJsonRpcAbstractSocket *socket, const QJsonRpcMessage &message,
+                         QJsonRpcAbstractSocket *peer = 0);
+    // dispatches, queues or refuses a request depending on the limits it falls under
+    static void admit(const QSharedPointer<Admission> &admission, Admission::Call call);
+    static void start(const QSharedPointer<Admission> &admission, const Admission::Call &call);
+    // starts admitted calls, each on the thread that received it
+    static void schedule(const QSharedPointer<Admission> &admission, const QList<Admission::Call> &calls);
+    static void release(const QSharedPointer<Admission> &admission,
+                        const QList<Admission::LimitPointer> &limits);
+    QSharedPointer<Admission> admission;
+
 };
 
+void AdmittedCall::notify(const QJsonRpcMessage &response)
+{
+    if (m_finished)
+        return;
+
+    m_finished = true;
+    if (m_target)
+        m_target->notify(response);
+    QJsonRpcServiceProviderPrivate::release(m_admission, m_limits);
+    deleteLater();
+}
+
+void QJsonRpcServiceProviderPrivate::dispatch(QJsonRpcService *service, const QByteArray &name, int group,
+                                              QJsonRpcAbstractSocket *socket, const QJsonRpcMessage &message,
+                                              QJsonRpcAbstractSocket *peer)
+{
+    QJsonRpcServicePrivate *dispatcher = service->d_func();
+    if (dispatcher->threadPool) {
+        dispatcher->dispatchConcurrently(message, name, group, socket, peer);
+    } else {
+        QJsonRpcMessage response = dispatcher->dispatch(message, name, group, socket, peer);
+        if (response.isValid())
+            socket->notify(response);
+    }
+}
+
+void QJsonRpcServiceProviderPrivate::admit(const QSharedPointer<Admission> &admission, Admission::Call call)
+{
+    const QString method = call.request.method();
+    const QString service = method.left(method.lastIndexOf(QLatin1Char('.')));
+    QString blocking;
+    {
+        QMutexLocker locker(&admission->lock);
+        if (admission->limits.isEmpty()) {
+            locker.unlock();
+            dispatch(call.service, call.name, call.group, call.socket, call.request, call.peer);
+            return;
+        }
+
+        QList<QString> names;
+        names << method;
+        if (service != method)
+            names << service;
+        for (const QString &name : qAsConst(names)) {
+            const Admission::LimitPointer limit = admission->limits.value(name);
+            if (limit)
+                call.limits.append(limit);
+            if (limit && blocking.isEmpty() && !limit->hasCapacity())
+                blocking = name;
+        }
+
+        if (!blocking.isEmpty()) {
+            // waits in the queue of the first limit without room
+            const Admission::LimitPointer limit = admission->limits.value(blocking);
+            if (limit->queue.size() < limit->maxQueued) {
+                limit->queue.append(call);
+                return;
+            }
+        } else {
+            for (const Admission::LimitPointer &limit : qAsConst(call.limits))
+                ++limit->inFlight;
+        }
+    }
+
+    if (!blocking.isEmpty()) {
+        QString message = QStringLiteral("too many pending requests for '%1'").arg(blocking);
+        call.socket->notify(call.request.createErrorResponse(QJsonRpc::ServerBusy, message));
+    } else if (call.limits.isEmpty()) {
+        dispatch(call.service, call.name, call.group, call.socket, call.request, call.peer);
+    } else {
+        start(admission, call);
+    }
+}
+
+void QJsonRpcServiceProviderPrivate::start(const QSharedPointer<Admission> &admission,
+                                           const Admission::Call &call)
+{
+    AdmittedCall *socket = new AdmittedCall(admission, call.limits, call.socket);
+    if (!call.service) {
+        socket->notify(call.request.createStandardErrorResponse(QJsonRpc::MethodNotFound));
+        return;
+    }
+
+    // only the response passes through the stand-in, the slot sees the client's socket
+    dispatch(call.service, call.name, call.group, socket, call.request, call.peer);
+}
+
+void QJsonRpcServiceProviderPrivate::schedule(const QSharedPointer<Admission> &admission,
+                                              const QList<Admission::Call> &calls)
+{
+    for (const Admission::Call &call : calls) {
+        if (call.thread == QThread::currentThread()) {
+            start(admission, call);
+            continue;
+        }
+
+        // the service, its sockets and the stand-in all belong to that thread
+        QObject *context = new QObject;
+        context->moveToThread(call.thread);
+        QMetaObject::invokeMethod(context, [admission, call, context]() {
+            start(admission, call);
+            delete context;
+        }, Qt::QueuedConnection);
+    }
+}
+
+void QJsonRpcServiceProviderPrivate::release(const QSharedPointer<Admission> &admission,
+                                             const QList<Admission::LimitPointer> &limits)
+{
+    QList<Admission::Call> admitted;
+    {
+        QMutexLocker locker(&admission->lock);
+        for (const Admission::LimitPointer &limit : limits) {
+            if (limit->inFlight > 0)
+                --limit->inFlight;
+        }
+        admitted = admission->takeAdmissible();
+    }
+
+    schedule(admission, admitted);
+}
+
 QJsonRpcServiceProvider::QJsonRpcServiceProvider()
     : d(new QJsonRpcServiceProviderPrivate)
 {
 }
 
+QJsonRpcAbstractSocket *QJsonRpcServiceProviderPrivate::joinFlight(QJsonRpcAbstractSocket *socket,
+                                                                    const QJsonRpcMessage &request)
+{
+    // the response differs for requests that take attachments, they fly apart
+    QByteArray key = request.acceptsAttachments() ? "@" : "";
+    key += request.method().toUtf8() + QJsonRpcServicePrivate::canonicalParameters(request.params());
+    QHash<QByteArray, QPointer<SingleFlight> >::iterator it = flights.find(key);
+    if (it != flights.end() && it.value() && it.value()->isJoinable()) {
+        it.value()->attach(socket, request);
+        return 0;
+    }
+
+    if (flights.size() >= nextFlightSweep) {
+        for (it = flights.begin(); it != flights.end();) {
+            if (!it.value() || !it.value()->isJoinable())
+                it = flights.erase(it);
+            else
+                ++it;
+        }
+        nextFlightSweep = qMax(int(MinimumFlightSweep), int(flights.size()) * 2);
+    }
+
+    SingleFlight *flight = new SingleFlight;
+    flight->attach(socket, request);
+    flights.insert(key, flight);
+    return flight;
+}
+
+void QJsonRpcServiceProviderPrivate::dropFlights(const QByteArray &serviceName)
+{
+    const QByteArray prefix = serviceName + '.';
+    QHash<QByteArray, QPointer<SingleFlight> >::iterator it = flights.begin();
+    while (it != flights.end()) {
+        const QByteArray &key = it.key();
+        const int offset = key.startsWith('@') ? 1 : 0;
+        // a late answer still reaches the waiters, new requests won't join
+        if (serviceName.isEmpty() || key.mid(offset, prefix.size()) == prefix)
+            it = flights.erase(it);
+        else
+            ++it;
+    }
+}
+
 QJsonRpcServiceProvider::~QJsonRpcServiceProvider()
 {
+    // the cleanup handler deletes services, none may still run on a thread pool
+    for (QJsonRpcService *service : qAsConst(d->services))
+        service->waitForJobs();
 }
 
 QByteArray QJsonRpcServiceProviderPrivate::serviceName(QJsonRpcService *service)
@@ -42,6 +459,34 @@ QByteArray QJsonRpcServiceProviderPrivate::serviceName(QJsonRpcService *service)
     return QByteArray(mo->className()).toLower();
 }
 
+QJsonRpcMethodHandle QJsonRpcServiceProviderPrivate::resolve(const QString &method)
+{
+    QHash<QString, QJsonRpcMethodHandle>::const_iterator it = methodHandles.constFind(method);
+    if (it != methodHandles.constEnd())
+        return it.value();
+
+    QJsonRpcMethodHandle handle;
+    const int separator = method.lastIndexOf(QLatin1Char('.'));
+    if (separator <= 0)
+        return handle;
+
+    QJsonRpcService *service = services.value(method.left(separator).toLatin1());
+    if (!service)
+        return handle;
+
+    handle.name = method.mid(separator + 1).toLatin1();
+    // registered methods are looked up again on dispatch, they can come and go
+    const int group = service->d_func()->methodTable()->findGroup(handle.name);
+    if (group < 0 && !service->d_func()->typedMethodTable().contains(handle.name))
+        return handle;
+
+    // only existing methods are interned, unknown names must not grow the cache
+    handle.service = service;
+    handle.group = group;
+    methodHandles.insert(method, handle);
+    return handle;
+}
+
 bool QJsonRpcServiceProvider::addService(QJsonRpcService *service)
 {
     QByteArray serviceName = d->serviceName(service);
@@ -57,6 +502,7 @@ bool QJsonRpcServiceProvider::addService(QJsonRpcService *service)
 
     service->d_func()->cacheInvokableInfo();
     d->services.insert(serviceName, service);
+    d->methodHandles.clear();
     if (!service->parent())
         d->cleanupHandler.add(service);
     return true;
@@ -72,15 +518,116 @@ bool QJsonRpcServiceProvider::removeService(QJsonRpcService *service)
 
     d->cleanupHandler.remove(d->services.value(serviceName));
     d->services.remove(serviceName);
+    d->methodHandles.clear();
+    d->dropFlights(serviceName);
+    // the caller may delete the service next, its calls on a thread pool finish first
+    service->waitForJobs();
     return true;
 }
 
 void QJsonRpcServiceProvider::removeAllServices()
 {
-    for (auto service : d->services) {
+    const QList<QJsonRpcService*> services = d->services.values();
+    for (auto service : services) {
         d->cleanupHandler.remove(service);
     }
     d->services.clear();
+    d->methodHandles.clear();
+    d->dropFlights(QByteArray());
+    for (auto service : services)
+        service->waitForJobs();
+}
+
+QByteArray QJsonRpcServiceProvider::compressionDictionary() const
+{
+    QList<QByteArray> serviceNames = d->services.keys();
+    std::sort(serviceNames.begin(), serviceNames.end());
+
+    QStringList parameterNames;
+    QByteArray methods;
+    for (const QByteArray &serviceName : qAsConst(serviceNames)) {
+        const QSharedPointer<const QJsonRpcServicePrivate::Metadata> service =
+            d->services.value(serviceName)->d_func()->methodTable();
+        QVector<QJsonRpcServicePrivate::MethodGroup> groups = service->groups;
+        std::sort(groups.begin(), groups.end(),
+                  [](const QJsonRpcServicePrivate::MethodGroup &a, const QJsonRpcServicePrivate::MethodGroup &b) {
+            return a.name < b.name;
+        });
+        for (const QJsonRpcServicePrivate::MethodGroup &group : qAsConst(groups)) {
+            methods += '"' + serviceName + '.' + group.name + '"';
+            for (int i = group.first; i < group.first + group.count; ++i) {
+                for (const QJsonRpcServicePrivate::ParameterInfo &parameter : service->methods.at(i).parameters) {
+                    if (!parameter.name.isEmpty() && !parameterNames.contains(parameter.name))
+                        parameterNames.append(parameter.name);
+                }
+            }
+        }
+
+        const QHash<QByteArray, QSharedPointer<const QJsonRpcServicePrivate::TypedMethod> > typedMethods =
+            d->services.value(serviceName)->d_func()->typedMethodTable();
+        QList<QByteArray> typedNames = typedMethods.keys();
+        std::sort(typedNames.begin(), typedNames.end());
+        for (const QByteArray &name : qAsConst(typedNames)) {
+            methods += '"' + serviceName + '.' + name + '"';
+            for (const QString &parameterName : typedMethods.value(name)->parameterNames) {
+                if (!parameterNames.contains(parameterName))
+                    parameterNames.append(parameterName);
+            }
+        }
+    }
+    parameterNames.sort();
+
+    // zlib favours matches close to the data, so the envelope every message
+    // carries goes last and the tail is kept when trimming to the window size
+    QByteArray dictionary;
+    for (const QString &name : qAsConst(parameterNames))
+        dictionary += '"' + name.toUtf8() + "\":";
+    dictionary += methods;
+    dictionary += "{\"error\":{\"code\":-32602,\"message\":\"invalid parameters\"},\"id\":";
+    dictionary += "{\"error\":{\"code\":-32601,\"message\":\"invalid method called\"},\"id\":";
+    dictionary += ",\"jsonrpc\":\"2.0\",\"result\":";
+    dictionary += "\",\"params\":{\"";
+    dictionary += "\",\"params\":[";
+    dictionary += "{\"id\":";
+    dictionary += ",\"jsonrpc\":\"2.0\",\"method\":\"";
+    if (dictionary.size() > QJsonRpcWireFormat::MaximumDictionarySize)
+        dictionary = dictionary.right(QJsonRpcWireFormat::MaximumDictionarySize);
+    return dictionary;
+}
+
+void QJsonRpcServiceProvider::setConcurrencyLimit(const QString &name, int maxConcurrent, int maxQueued)
+{
+    QList<Admission::Call> admitted;
+    {
+        QMutexLocker locker(&d->admission->lock);
+        if (maxConcurrent < 0) {
+            admitted = d->admission->remove(name);
+        } else {
+            Admission::LimitPointer &limit = d->admission->limits[name];
+            if (!limit)
+                limit = Admission::LimitPointer::create();
+            limit->maxConcurrent = maxConcurrent;
+            limit->maxQueued = qMax(0, maxQueued);
+        }
+        admitted += d->admission->takeAdmissible();
+    }
+
+    // not started here, the caller may be on any thread
+    d->schedule(d->admission, admitted);
+}
+
+int QJsonRpcServiceProvider::inFlightCount(const QString &name) const
+{
+    QMutexLocker locker(&d->admission->lock);
+    const Admission::LimitPointer limit = d->admission->limits.value(name);
+    return limit ? limit->inFlight : 0;
+}
+
+int QJsonRpcServiceProvider::queuedCount(const QString &name) const
+{
+    QMutexLocker locker(&d->admission->lock);
+    const Admission::LimitPointer limit = d->admission->limits.value(name);
+    return limit ? int(limit->queue.size()) : 0;
 }
 
 void QJsonRpcServiceProvider::processMessage(QJsonRpcAbstractSocket *socket, const QJsonRpcMessage &message)
@@ -88,23 +635,39 @@ void QJsonRpcServiceProvider::processMessage(QJsonRpcAbstractSocket *socket, con
     switch (message.type()) {
         case QJsonRpcMessage::Request:
         case QJsonRpcMessage::Notification: {
-            QByteArray serviceName = message.method().section(QLatin1Char('.'), 0, -2).toLatin1();
-            if (serviceName.isEmpty() || !d->services.contains(serviceName)) {
-                if (message.type() == QJsonRpcMessage::Request) {
-                    QJsonRpcMessage error =
-                        message.createErrorResponse(QJsonRpc::MethodNotFound,
-                            QStringLiteral("service '%1' not found").arg(QString::fromUtf8(serviceName)));
-                    socket->notify(error);
-                }
+            const QJsonRpcMethodHandle handle = d->resolve(message.method());
+            if (!handle.service) {
+                qJsonRpcDebug() << "method" << message.method() << "not found";
+                if (message.type() == QJsonRpcMessage::Request)
+                    socket->notify(message.createStandardErrorResponse(QJsonRpc::MethodNotFound));
             } else {
-                QJsonRpcService *service = d->services.value(serviceName);
-                service->d_func()->currentRequest = QJsonRpcServiceRequest(message, socket);
+                QJsonRpcService *service = handle.service;
                 if (message.type() == QJsonRpcMessage::Request)
                     QObject::connect(service, &QJsonRpcService::result,
                                       socket, &QJsonRpcAbstractSocket::notify, Qt::UniqueConnection);
-                QJsonRpcMessage response = service->dispatch(message);
-                if (response.isValid())
-                    socket->notify(response);
+                if (message.type() == QJsonRpcMessage::Notification) {
+                    d->dispatch(service, handle.name, handle.group, socket, message);
+                    break;
+                }
+
+                // requests joining one in flight don't count against the limits. A new
+                // flight only relays the response, the slot still gets socket as its peer
+                QJsonRpcAbstractSocket *replySocket = socket;
+                if (service->isSingleFlight(handle.name)) {
+                    replySocket = d->joinFlight(socket, message);
+                    if (!replySocket)
+                        break;
+                }
+
+                Admission::Call call;
+                call.service = service;
+                call.name = handle.name;
+                call.group = handle.group;
+                call.socket = replySocket;
+                call.peer = socket;
+                call.request = message;
+                call.thread = QThread::currentThread();
+                d->admit(d->admission, call);
             }
         }
         break;
@@ -113,11 +676,8 @@ void QJsonRpcServiceProvider::processMessage(QJsonRpcAbstractSocket *socket, con
             // we don't handle responses in the provider
             break;
 
-        default: {
-            QJsonRpcMessage error =
-                message.createErrorResponse(QJsonRpc::InvalidRequest, QStringLiteral("invalid request"));
-            socket->notify(error);
+        default:
+            socket->notify(message.createStandardErrorResponse(QJsonRpc::InvalidRequest));
             break;
-        }
     };
 }
@@ -17,6 +17,9 @@
 #ifndef QJSONRPCSERVICEPROVIDER_H
 #define QJSONRPCSERVICEPROVIDER_H
 
+#include <QByteArray>
+#include <QString>
+
 #include "qjsonrpcglobal.h"
 
 class QJsonRpcMessage;
@@ -31,6 +34,19 @@ public:
     virtual bool removeService(QJsonRpcService *service);
     virtual void removeAllServices();
 
+    // preset dictionary for QJsonRpcSocket::setCompressionDictionary() built from
+    // the registered methods, deterministic for the same set of services
+    QByteArray compressionDictionary() const;
+
+    // runs at most maxConcurrent requests to a method ("service.method") or a
+    // whole service ("service") at once, up to maxQueued more wait for their
+    // turn and further ones are refused with QJsonRpc::ServerBusy. A negative
+    // maxConcurrent removes the limit and lets its waiting requests go ahead.
+    // Notifications bypass limits. Safe to call from any thread.
+    void setConcurrencyLimit(const QString &name, int maxConcurrent, int maxQueued = 0);
+    int inFlightCount(const QString &name) const;
+    int queuedCount(const QString &name) const;
+
 protected:
     QJsonRpcServiceProvider();
     void processMessage(QJsonRpcAbstractSocket *socket, const QJsonRpcMessage &message);
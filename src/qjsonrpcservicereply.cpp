@@ -17,6 +17,9 @@
 #include "qjsonrpcservicereply_p.h"
 #include "qjsonrpcservicereply.h"
 
+QJSONRPC_DEFINE_POOLED_ALLOCATOR(QJsonRpcServiceReplyPrivate)
+QJSONRPC_DEFINE_POOLED_ALLOCATOR(QJsonRpcServiceReply)
+
 QJsonRpcServiceReply::QJsonRpcServiceReply(QObject *parent)
 #if defined(USE_QT_PRIVATE_HEADERS)
     : QObject(*new QJsonRpcServiceReplyPrivate, parent)
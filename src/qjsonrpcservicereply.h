@@ -34,6 +34,10 @@ public:
     QJsonRpcMessage request() const;
     QJsonRpcMessage response() const;
 
+    // replies are recycled through a per-thread free list
+    static void *operator new(std::size_t size);
+    static void operator delete(void *block, std::size_t size);
+
 Q_SIGNALS:
     void finished();
 
@@ -17,6 +17,7 @@
 #ifndef QJSONRPCSERVICEREPLY_P_H
 #define QJSONRPCSERVICEREPLY_P_H
 
+#include "qjsonrpcobjectpool_p.h"
 #include "qjsonrpcmessage.h"
 
 #if defined(USE_QT_PRIVATE_HEADERS)
@@ -28,6 +29,11 @@ class QJsonRpcServiceReplyPrivate
 #endif
 {
 public:
+#if !defined(USE_QT_PRIVATE_HEADERS)
+    virtual ~QJsonRpcServiceReplyPrivate() {}
+#endif
+    QJSONRPC_DECLARE_POOLED_ALLOCATOR
+
     QJsonRpcMessage request;
     QJsonRpcMessage response;
 };
@@ -12,6 +12,7 @@
 #include "qjsonrpcservicereply_p.h"
 #include "qjsonrpcservicereply.h"
 #include "qjsonrpcsocket_p.h"
+#include "qjsonrpcwireformat_p.h"
 #include "qjsonrpcsocket.h"
 
 int QJsonRpcSocketPrivate::findJsonDocumentEnd(const QByteArray &jsonData)
@@ -71,12 +72,41 @@ int QJsonRpcSocketPrivate::findJsonDocumentEnd(const QByteArray &jsonData)
 void QJsonRpcSocketPrivate::writeData(const QJsonRpcMessage &message)
 {
     Q_Q(QJsonRpcSocket);
-    QJsonDocument doc = QJsonDocument(message.toObject());
+    QByteArray data;
+    if (wireFormat == QJsonRpcSocket::JsonWireFormat) {
+        const QJsonRpcMessage inlined = message.inlineAttachments();
 #if QT_VERSION >= 0x050100 || QT_VERSION <= 0x050000
-    QByteArray data = doc.toJson(QJsonDocument::Compact);
+        data = inlined.toJson(QJsonDocument::Compact);
 #else
-    QByteArray data = doc.toJson();
+        data = inlined.toJson();
 #endif
+    } else {
+        const QList<QByteArray> attachments = message.attachments();
+        if (attachments.size() > QJsonRpcWireFormat::MaximumAttachments) {
+            qJsonRpcDebug() << Q_FUNC_INFO << "too many attachments:" << attachments.size();
+            return;
+        }
+
+        QList<QByteArray> headers;
+        for (const QByteArray &attachment : attachments) {
+            headers.append(QJsonRpcWireFormat::attachmentHeader(attachment.size()));
+            if (headers.last().isEmpty()) {
+                qJsonRpcDebug() << Q_FUNC_INFO << "attachment too large:" << attachment.size();
+                return;
+            }
+        }
+
+        data = QJsonRpcWireFormat::encodeFrame(wireFormat, message, compressionThreshold,
+                                                compressionDictionary);
+        if (data.isEmpty())
+            return;
+
+        // attachments go first, the receiver hands them to the next message frame
+        for (int i = 0; i < attachments.size(); ++i) {
+            device.data()->write(headers.at(i));
+            device.data()->write(attachments.at(i));
+        }
+    }
 
     device.data()->write(data);
     qJsonRpcDebug() << "sending(" << q << "): " << data;
@@ -236,6 +266,52 @@ bool QJsonRpcSocket::isValid() const
     return d->device && d->device.data()->isOpen();
 }
 
+void QJsonRpcSocket::setWireFormat(WireFormat format)
+{
+    Q_D(QJsonRpcSocket);
+    if (!QJsonRpcWireFormat::isSupported(format)) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "unsupported wire format" << format;
+        return;
+    }
+
+    d->wireFormat = format;
+}
+
+QJsonRpcSocket::WireFormat QJsonRpcSocket::wireFormat() const
+{
+    Q_D(const QJsonRpcSocket);
+    return d->wireFormat;
+}
+
+void QJsonRpcSocket::setCompressionThreshold(int bytes)
+{
+    Q_D(QJsonRpcSocket);
+    d->compressionThreshold = bytes < 0 ? -1 : bytes;
+}
+
+int QJsonRpcSocket::compressionThreshold() const
+{
+    Q_D(const QJsonRpcSocket);
+    return d->compressionThreshold;
+}
+
+void QJsonRpcSocket::setCompressionDictionary(const QByteArray &dictionary)
+{
+    Q_D(QJsonRpcSocket);
+    if (!dictionary.isEmpty() && !QJsonRpcWireFormat::hasDictionarySupport()) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "built without zlib, ignoring compression dictionary";
+        return;
+    }
+
+    d->compressionDictionary = dictionary;
+}
+
+QByteArray QJsonRpcSocket::compressionDictionary() const
+{
+    Q_D(const QJsonRpcSocket);
+    return d->compressionDictionary;
+}
+
 /*
 void QJsonRpcSocket::sendMessage(const QList<QJsonRpcMessage> &messages)
 {
@@ -306,20 +382,10 @@ QJsonRpcMessage QJsonRpcSocket::invokeRemoteMethodBlocking(const QString &method
                                                            const QVariant &param8, const QVariant &param9,
                                                            const QVariant &param10)
 {
-    QVariantList params;
-    if (param1.isValid()) params.append(param1);
-    if (param2.isValid()) params.append(param2);
-    if (param3.isValid()) params.append(param3);
-    if (param4.isValid()) params.append(param4);
-    if (param5.isValid()) params.append(param5);
-    if (param6.isValid()) params.append(param6);
-    if (param7.isValid()) params.append(param7);
-    if (param8.isValid()) params.append(param8);
-    if (param9.isValid()) params.append(param9);
-    if (param10.isValid()) params.append(param10);
-
-    QJsonRpcMessage request =
-        QJsonRpcMessage::createRequest(method, QJsonArray::fromVariantList(params));
+    const QJsonArray params = QJsonRpcAbstractSocketPrivate::paramsFromVariants({
+        &param1, &param2, &param3, &param4, &param5, &param6, &param7, &param8, &param9, &param10 });
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest(method, params);
     return sendMessageBlocking(request, msecs);
 }
 
@@ -341,20 +407,10 @@ QJsonRpcServiceReply *QJsonRpcSocket::invokeRemoteMethod(const QString &method,
                                                          const QVariant &param8, const QVariant &param9,
                                                          const QVariant &param10)
 {
-    QVariantList params;
-    if (param1.isValid()) params.append(param1);
-    if (param2.isValid()) params.append(param2);
-    if (param3.isValid()) params.append(param3);
-    if (param4.isValid()) params.append(param4);
-    if (param5.isValid()) params.append(param5);
-    if (param6.isValid()) params.append(param6);
-    if (param7.isValid()) params.append(param7);
-    if (param8.isValid()) params.append(param8);
-    if (param9.isValid()) params.append(param9);
-    if (param10.isValid()) params.append(param10);
-
-    QJsonRpcMessage request =
-        QJsonRpcMessage::createRequest(method, QJsonArray::fromVariantList(params));
+    const QJsonArray params = QJsonRpcAbstractSocketPrivate::paramsFromVariants({
+        &param1, &param2, &param3, &param4, &param5, &param6, &param7, &param8, &param9, &param10 });
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest(method, params);
     return sendMessage(request);
 }
 
@@ -367,6 +423,11 @@ void QJsonRpcSocketPrivate::_q_processIncomingData()
     }
 
     buffer.append(device.data()->readAll());
+    if (wireFormat != QJsonRpcSocket::JsonWireFormat) {
+        processIncomingFrames();
+        return;
+    }
+
     while (!buffer.isEmpty()) {
         int dataSize = findJsonDocumentEnd(buffer);
         if (dataSize == -1) {
@@ -398,22 +459,109 @@ void QJsonRpcSocketPrivate::_q_processIncomingData()
             */
         } else if (document.isObject()){
             qJsonRpcDebug() << "received(" << q << "): " << document.toJson(QJsonDocument::Compact);
-            QJsonRpcMessage message = QJsonRpcMessage::fromObject(document.object());
-            Q_EMIT q->messageReceived(message);
-
-            if (message.type() == QJsonRpcMessage::Response ||
-                message.type() == QJsonRpcMessage::Error) {
-                if (replies.contains(message.id())) {
-                    QPointer<QJsonRpcServiceReply> reply = replies.take(message.id());
-                    if (!reply.isNull()) {
-                        reply->d_func()->response = message;
-                        Q_EMIT reply->finished();
-                    }
-                }
+            processIncomingMessage(QJsonRpcMessage::fromObject(document.object()));
+        }
+    }
+}
+
+void QJsonRpcSocketPrivate::processIncomingFrames()
+{
+    Q_Q(QJsonRpcSocket);
+    int flags = 0;
+    int payloadSize = 0;
+    while (QJsonRpcWireFormat::readHeader(buffer, &flags, &payloadSize)) {
+        if (buffer.size() - QJsonRpcWireFormat::HeaderSize < payloadSize) {
+            // incomplete frame, wait for more
+            return;
+        }
+
+        if (flags & QJsonRpcWireFormat::AttachmentFrame) {
+            if (flags != QJsonRpcWireFormat::AttachmentFrame ||
+                pendingAttachments.size() >= QJsonRpcWireFormat::MaximumAttachments) {
+                qJsonRpcDebug() << Q_FUNC_INFO << "dropping malformed frame of" << payloadSize << "bytes";
+                pendingAttachments.clear();
             } else {
-                q->processRequestMessage(message);
+                pendingAttachments.append(buffer.mid(QJsonRpcWireFormat::HeaderSize, payloadSize));
+            }
+            buffer.remove(0, QJsonRpcWireFormat::HeaderSize + payloadSize);
+            continue;
+        }
+
+        // decode in place, the frame is dropped before the message is handled
+        // since handlers may spin an event loop and reenter this function
+        QJsonObject object;
+        const QByteArray payload =
+            QByteArray::fromRawData(buffer.constData() + QJsonRpcWireFormat::HeaderSize, payloadSize);
+        bool valid = QJsonRpcWireFormat::decodeFrame(wireFormat, flags, payload, &object,
+                                                       compressionDictionary);
+        quint32 frameDictionary = 0;
+        const bool dictionaryMismatch = !valid && (flags & QJsonRpcWireFormat::DictionaryFrame) &&
+            QJsonRpcWireFormat::readDictionaryId(payload, &frameDictionary) &&
+            frameDictionary != QJsonRpcWireFormat::dictionaryId(compressionDictionary);
+        buffer.remove(0, QJsonRpcWireFormat::HeaderSize + payloadSize);
+        QList<QByteArray> attachments;
+        attachments.swap(pendingAttachments);
+        if (dictionaryMismatch) {
+            qJsonRpcDebug() << Q_FUNC_INFO << "dropping frame deflated with unknown dictionary"
+                            << frameDictionary;
+            rejectDictionaryFrame(frameDictionary);
+            continue;
+        }
+
+        if (!valid) {
+            qJsonRpcDebug() << Q_FUNC_INFO << "dropping malformed frame of" << payloadSize << "bytes";
+            continue;
+        }
+
+        QJsonRpcMessage message = QJsonRpcMessage::fromObject(object);
+        message.setAttachments(attachments);
+        message.setAcceptsAttachments(true);
+        qJsonRpcDebug() << "received(" << q << "): " << message;
+        processIncomingMessage(message);
+    }
+}
+
+void QJsonRpcSocketPrivate::rejectDictionaryFrame(quint32 frameDictionary)
+{
+    // the request id is inside the frame we couldn't inflate, so the error has a
+    // null id like any parse error. It goes out uncompressed, the peer can read
+    // it whatever dictionary it uses.
+    QJsonObject data;
+    data.insert(QLatin1String("expected"),
+                static_cast<double>(QJsonRpcWireFormat::dictionaryId(compressionDictionary)));
+    data.insert(QLatin1String("received"), static_cast<double>(frameDictionary));
+
+    QJsonObject error;
+    error.insert(QLatin1String("code"), QJsonRpc::ParseError);
+    error.insert(QLatin1String("message"), QLatin1String("compression dictionary mismatch"));
+    error.insert(QLatin1String("data"), data);
+
+    QJsonObject object;
+    object.insert(QLatin1String("jsonrpc"), QLatin1String("2.0"));
+    object.insert(QLatin1String("id"), QJsonValue());
+    object.insert(QLatin1String("error"), error);
+
+    const QByteArray frame = QJsonRpcWireFormat::encodeFrame(wireFormat, object);
+    if (!frame.isEmpty() && device)
+        device.data()->write(frame);
+}
+
+void QJsonRpcSocketPrivate::processIncomingMessage(const QJsonRpcMessage &message)
+{
+    Q_Q(QJsonRpcSocket);
+    Q_EMIT q->messageReceived(message);
+
+    if (message.type() == QJsonRpcMessage::Response ||
+        message.type() == QJsonRpcMessage::Error) {
+        if (replies.contains(message.id())) {
+            QPointer<QJsonRpcServiceReply> reply = replies.take(message.id());
+            if (!reply.isNull()) {
+                reply->d_func()->response = message;
+                Q_EMIT reply->finished();
             }
         }
+    } else {
+        q->processRequestMessage(message);
     }
 }
 
@@ -40,6 +40,21 @@ public:
     void setDefaultRequestTimeout(int msecs);
     int getDefaultRequestTimeout() const;
 
+    // variadic counterparts of invokeRemoteMethod(), each argument is converted
+    // straight to a QJsonValue through QJsonRpc::JsonValueConverter
+    template <typename... Args>
+    QJsonRpcServiceReply *invoke(const QString &method, const Args &... args)
+    {
+        return sendMessage(QJsonRpcMessage::createRequest(method, QJsonRpc::toJsonArray(args...)));
+    }
+
+    template <typename... Args>
+    QJsonRpcMessage invokeBlocking(const QString &method, const Args &... args)
+    {
+        return sendMessageBlocking(QJsonRpcMessage::createRequest(method, QJsonRpc::toJsonArray(args...)),
+                                   getDefaultRequestTimeout());
+    }
+
 Q_SIGNALS:
     void messageReceived(const QJsonRpcMessage &message);
 
@@ -86,7 +101,30 @@ public:
     explicit QJsonRpcSocket(QIODevice *device, QObject *parent = 0);
     ~QJsonRpcSocket();
 
+    // both peers of a connection have to use the same wire format
+    enum WireFormat {
+        JsonWireFormat,         // JSON text, delimited by the document braces
+        CborWireFormat,         // length prefixed CBOR frames
+        MessagePackWireFormat,  // length prefixed MessagePack frames
+        BinaryJsonWireFormat,   // length prefixed Qt binary JSON, Qt 5 only
+        FramedJsonWireFormat    // length prefixed compact JSON
+    };
+
     virtual bool isValid() const;
+    void setWireFormat(WireFormat format);
+    WireFormat wireFormat() const;
+
+    // framed formats only: outgoing messages above this size are sent compressed,
+    // -1 (the default) disables compression. Compressed frames are always accepted.
+    void setCompressionThreshold(int bytes);
+    int compressionThreshold() const;
+
+    // preset deflate dictionary for compressed frames, needs zlib. Both peers have
+    // to use the same one, see QJsonRpcServiceProvider::compressionDictionary().
+    // A frame deflated with another dictionary is answered with a parse error
+    // carrying both dictionary ids in its data.
+    void setCompressionDictionary(const QByteArray &dictionary);
+    QByteArray compressionDictionary() const;
 
 public Q_SLOTS:
     virtual void notify(const QJsonRpcMessage &message);
@@ -21,6 +21,8 @@
 #include <QHash>
 #include <QIODevice>
 
+#include <initializer_list>
+
 #include "qjsonrpcsocket.h"
 #include "qjsonrpcmessage.h"
 #include "qjsonrpcglobal.h"
@@ -38,6 +40,15 @@ public:
         : defaultRequestTimeout(DEFAULT_MSECS_REQUEST_TIMEOUT)
     {}
 
+    static QJsonArray paramsFromVariants(std::initializer_list<const QVariant *> variants) {
+        QJsonArray params;
+        for (const QVariant *variant : variants) {
+            if (variant->isValid())
+                params.append(QJsonValue::fromVariant(*variant));
+        }
+        return params;
+    }
+
     int defaultRequestTimeout;
 
 #if !defined(USE_QT_PRIVATE_HEADERS)
@@ -50,7 +61,9 @@ class QJSONRPC_EXPORT QJsonRpcSocketPrivate : public QJsonRpcAbstractSocketPriva
 {
 public:
     QJsonRpcSocketPrivate(QJsonRpcSocket *socket)
-        : q_ptr(socket)
+        : wireFormat(QJsonRpcSocket::JsonWireFormat),
+          compressionThreshold(-1),
+          q_ptr(socket)
     {}
 
 #if !defined(USE_QT_PRIVATE_HEADERS)
@@ -61,10 +74,18 @@ public:
     virtual void _q_processIncomingData();
 
     int findJsonDocumentEnd(const QByteArray &jsonData);
+    void processIncomingFrames();
+    void processIncomingMessage(const QJsonRpcMessage &message);
+    // answers a frame deflated with another preset dictionary than ours
+    void rejectDictionaryFrame(quint32 frameDictionary);
     void writeData(const QJsonRpcMessage &message);
 
+    QJsonRpcSocket::WireFormat wireFormat;
+    int compressionThreshold;
+    QByteArray compressionDictionary;
     QPointer<QIODevice> device;
     QByteArray buffer;
+    QList<QByteArray> pendingAttachments;
     QHash<int, QPointer<QJsonRpcServiceReply> > replies;
 
     QJsonRpcSocket * const q_ptr;
@@ -3,6 +3,7 @@
 
 #include "qjsonrpcsocket.h"
 #include "qjsonrpcabstractserver_p.h"
+#include "qjsonrpcwireformat_p.h"
 #include "qjsonrpctcpserver.h"
 
 class QJsonRpcTcpServerPrivate : public QJsonRpcAbstractServerPrivate
@@ -35,6 +36,52 @@ QJsonRpcTcpServer::~QJsonRpcTcpServer()
     d->clients.clear();
 }
 
+void QJsonRpcTcpServer::setWireFormat(QJsonRpcSocket::WireFormat format)
+{
+    Q_D(QJsonRpcTcpServer);
+    if (!QJsonRpcWireFormat::isSupported(format)) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "unsupported wire format" << format;
+        return;
+    }
+
+    d->wireFormat = format;
+}
+
+QJsonRpcSocket::WireFormat QJsonRpcTcpServer::wireFormat() const
+{
+    Q_D(const QJsonRpcTcpServer);
+    return d->wireFormat;
+}
+
+void QJsonRpcTcpServer::setCompressionThreshold(int bytes)
+{
+    Q_D(QJsonRpcTcpServer);
+    d->compressionThreshold = bytes < 0 ? -1 : bytes;
+}
+
+int QJsonRpcTcpServer::compressionThreshold() const
+{
+    Q_D(const QJsonRpcTcpServer);
+    return d->compressionThreshold;
+}
+
+void QJsonRpcTcpServer::setCompressionDictionary(const QByteArray &dictionary)
+{
+    Q_D(QJsonRpcTcpServer);
+    if (!dictionary.isEmpty() && !QJsonRpcWireFormat::hasDictionarySupport()) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "built without zlib, ignoring compression dictionary";
+        return;
+    }
+
+    d->compressionDictionary = dictionary;
+}
+
+QByteArray QJsonRpcTcpServer::compressionDictionary() const
+{
+    Q_D(const QJsonRpcTcpServer);
+    return d->compressionDictionary;
+}
+
 bool QJsonRpcTcpServer::addService(QJsonRpcService *service)
 {
     if (!QJsonRpcServiceProvider::addService(service))
@@ -81,6 +128,9 @@ void QJsonRpcTcpServer::incomingConnection(int socketDescriptor)
 
     QIODevice *device = qobject_cast<QIODevice*>(tcpSocket);
     QJsonRpcSocket *socket = new QJsonRpcSocket(device, this);
+    socket->setWireFormat(d->wireFormat);
+    socket->setCompressionThreshold(d->compressionThreshold);
+    socket->setCompressionDictionary(d->compressionDictionary);
     connect(socket, SIGNAL(messageReceived(QJsonRpcMessage)),
               this, SLOT(_q_processMessage(QJsonRpcMessage)));
     d->clients.append(socket);
@@ -19,6 +19,7 @@
 
 #include <QTcpServer>
 #include "qjsonrpcabstractserver.h"
+#include "qjsonrpcsocket.h"
 
 class QJsonRpcTcpServerPrivate;
 class QJSONRPC_EXPORT QJsonRpcTcpServer : public QTcpServer, public QJsonRpcAbstractServer
@@ -30,6 +31,14 @@ public:
 
     virtual int connectedClientCount() const;
 
+    // applies to connections accepted afterwards
+    void setWireFormat(QJsonRpcSocket::WireFormat format);
+    QJsonRpcSocket::WireFormat wireFormat() const;
+    void setCompressionThreshold(int bytes);
+    int compressionThreshold() const;
+    void setCompressionDictionary(const QByteArray &dictionary);
+    QByteArray compressionDictionary() const;
+
     // reimp
     bool addService(QJsonRpcService *service);
     bool removeService(QJsonRpcService *service);
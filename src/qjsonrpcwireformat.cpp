@@ -0,0 +1,940 @@
+/*
+ * Copyright (C) 2012-2013 Matt Broadstone
+ * Contact: http://bitbucket.org/devonit/qjsonrpc
+ *
+ * This file is part of the QJsonRpc Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QtEndian>
+#include <QDebug>
+
+#include <cstring>
+
+#if QT_VERSION >= 0x050000
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QJsonDocument>
+#else
+#include "json/qjsonarray.h"
+#include "json/qjsonvalue.h"
+#include "json/qjsondocument.h"
+#endif
+
+#if defined(QJSONRPC_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#include "qjsonrpcwireformat_p.h"
+
+bool QJsonRpcWireFormat::isSupported(QJsonRpcSocket::WireFormat format)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // the binary representation was dropped with Qt 6
+    if (format == QJsonRpcSocket::BinaryJsonWireFormat)
+        return false;
+#endif
+
+    return format >= QJsonRpcSocket::JsonWireFormat &&
+           format <= QJsonRpcSocket::FramedJsonWireFormat;
+}
+
+bool QJsonRpcWireFormat::hasDictionarySupport()
+{
+#if defined(QJSONRPC_HAVE_ZLIB)
+    return true;
+#else
+    return false;
+#endif
+}
+
+QByteArray QJsonRpcWireFormat::encodeFrame(QJsonRpcSocket::WireFormat format, const QJsonObject &object,
+                                           int compressionThreshold, const QByteArray &dictionary)
+{
+    return buildFrame(encodePayload(format, object), compressionThreshold, dictionary);
+}
+
+QByteArray QJsonRpcWireFormat::encodeFrame(QJsonRpcSocket::WireFormat format, const QJsonRpcMessage &message,
+                                           int compressionThreshold, const QByteArray &dictionary)
+{
+    return buildFrame(message.framePayload(format), compressionThreshold, dictionary);
+}
+
+QByteArray QJsonRpcWireFormat::encodePayload(QJsonRpcSocket::WireFormat format, const QJsonObject &object)
+{
+    QByteArray payload;
+    switch (format) {
+    case QJsonRpcSocket::CborWireFormat:
+        encodeCbor(object, &payload);
+        break;
+    case QJsonRpcSocket::MessagePackWireFormat:
+        encodeMessagePack(object, &payload);
+        break;
+    case QJsonRpcSocket::BinaryJsonWireFormat:
+        encodeBinaryJson(object, &payload);
+        break;
+    case QJsonRpcSocket::FramedJsonWireFormat:
+        payload = QJsonDocument(object).toJson(QJsonDocument::Compact);
+        break;
+    default:
+        qJsonRpcDebug() << Q_FUNC_INFO << "unframed wire format" << format;
+        break;
+    }
+
+    return payload;
+}
+
+QByteArray QJsonRpcWireFormat::buildFrame(const QByteArray &payload, int compressionThreshold,
+                                          const QByteArray &dictionary)
+{
+    if (payload.isEmpty())
+        return QByteArray();
+
+    int flags = NoFlags;
+    QByteArray body = payload;
+    if (compressionThreshold >= 0 && payload.size() > compressionThreshold) {
+        QByteArray compressed;
+        int compressedFlag = CompressedFrame;
+        if (!dictionary.isEmpty() &&
+            deflateWithDictionary(payload.constData(), payload.size(), dictionary, &compressed)) {
+            compressedFlag = DictionaryFrame;
+        } else {
+            compressed = qCompress(payload);
+        }
+
+        if (compressed.size() < payload.size()) {
+            body = compressed;
+            flags |= compressedFlag;
+        }
+    }
+
+    if (body.size() > MaximumPayloadSize) {
+        qJsonRpcDebug() << Q_FUNC_INFO << "message exceeds the maximum frame size";
+        return QByteArray();
+    }
+
+    QByteArray frame;
+    frame.reserve(HeaderSize + body.size());
+    frame.resize(HeaderSize);
+    frame.append(body);
+    writeHeader(&frame, flags);
+    return frame;
+}
+
+QByteArray QJsonRpcWireFormat::attachmentHeader(int size)
+{
+    if (size < 0 || size > MaximumPayloadSize)
+        return QByteArray();
+
+    QByteArray header(HeaderSize, Qt::Uninitialized);
+    qToBigEndian<quint32>((static_cast<quint32>(AttachmentFrame) << 28) | static_cast<quint32>(size),
+                          header.data());
+    return header;
+}
+
+bool QJsonRpcWireFormat::decodeFrame(QJsonRpcSocket::WireFormat format, int flags,
+                                     const QByteArray &payload, QJsonObject *object,
+                                     const QByteArray &dictionary)
+{
+    if ((flags & ~KnownFlags) || (flags & AttachmentFrame) ||
+        ((flags & CompressedFrame) && (flags & DictionaryFrame)))
+        return false;
+
+    if (flags & DictionaryFrame) {
+        QByteArray uncompressed;
+        if (!inflateWithDictionary(payload, dictionary, &uncompressed))
+            return false;
+        return decodePayload(format, uncompressed, object);
+    }
+
+    if (!(flags & CompressedFrame))
+        return decodePayload(format, payload, object);
+
+    // qCompress() output is the same size prefixed zlib stream, qUncompress() would
+    // allocate whatever size the peer claims up front
+    QByteArray uncompressed;
+#if defined(QJSONRPC_HAVE_ZLIB)
+    if (!inflateWithDictionary(payload, QByteArray(), &uncompressed))
+        return false;
+#else
+    quint32 size = 0;
+    if (!readUncompressedSize(payload, &size))
+        return false;
+
+    uncompressed = qUncompress(payload);
+    if (uncompressed.isEmpty())
+        return false;
+#endif
+
+    return decodePayload(format, uncompressed, object);
+}
+
+bool QJsonRpcWireFormat::decodePayload(QJsonRpcSocket::WireFormat format, const QByteArray &payload,
+                                       QJsonObject *object)
+{
+    switch (format) {
+    case QJsonRpcSocket::CborWireFormat:
+        return decodeCbor(payload, object);
+    case QJsonRpcSocket::MessagePackWireFormat:
+        return decodeMessagePack(payload, object);
+    case QJsonRpcSocket::BinaryJsonWireFormat:
+        return decodeBinaryJson(payload, object);
+    case QJsonRpcSocket::FramedJsonWireFormat: {
+        const QJsonDocument document = QJsonDocument::fromJson(payload);
+        if (!document.isObject())
+            return false;
+        *object = document.object();
+        return true;
+    }
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool QJsonRpcWireFormat::readHeader(const QByteArray &data, int *flags, int *payloadSize)
+{
+    if (data.size() < HeaderSize)
+        return false;
+
+    const quint32 header = qFromBigEndian<quint32>(data.constData());
+    *flags = static_cast<int>(header >> 28);
+    *payloadSize = static_cast<int>(header & MaximumPayloadSize);
+    return true;
+}
+
+void QJsonRpcWireFormat::writeHeader(QByteArray *frame, int flags)
+{
+    const quint32 header = (static_cast<quint32>(flags) << 28) |
+                           static_cast<quint32>(frame->size() - HeaderSize);
+    qToBigEndian<quint32>(header, frame->data());
+}
+
+static void writeCborValue(QCborStreamWriter &writer, const QJsonValue &value)
+{
+    switch (value.type()) {
+    case QJsonValue::Null:
+        writer.append(nullptr);
+        break;
+    case QJsonValue::Bool:
+        writer.append(value.toBool());
+        break;
+    case QJsonValue::Double: {
+        // integral numbers take the compact integer encodings
+        const double number = value.toDouble();
+        if (number > -9007199254740992.0 && number < 9007199254740992.0 &&
+            number == static_cast<double>(static_cast<qint64>(number)))
+            writer.append(static_cast<qint64>(number));
+        else
+            writer.append(number);
+        break;
+    }
+    case QJsonValue::String:
+        writer.append(value.toString());
+        break;
+    case QJsonValue::Array: {
+        const QJsonArray array = value.toArray();
+        writer.startArray(static_cast<quint64>(array.size()));
+        for (const QJsonValue &element : array)
+            writeCborValue(writer, element);
+        writer.endArray();
+        break;
+    }
+    case QJsonValue::Object: {
+        const QJsonObject object = value.toObject();
+        writer.startMap(static_cast<quint64>(object.size()));
+        for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+            writer.append(it.key());
+            writeCborValue(writer, it.value());
+        }
+        writer.endMap();
+        break;
+    }
+    case QJsonValue::Undefined:
+        writer.appendUndefined();
+        break;
+    }
+}
+
+void QJsonRpcWireFormat::encodeCbor(const QJsonObject &object, QByteArray *output)
+{
+    QCborStreamWriter writer(output);
+    writeCborValue(writer, QJsonValue(object));
+}
+
+static bool readCborString(QCborStreamReader &reader, QString *string)
+{
+    QCborStreamReader::StringResult<QString> chunk = reader.readString();
+    while (chunk.status == QCborStreamReader::Ok) {
+        string->append(chunk.data);
+        chunk = reader.readString();
+    }
+
+    return chunk.status == QCborStreamReader::EndOfString;
+}
+
+static bool readCborValue(QCborStreamReader &reader, QJsonValue *value, int depth)
+{
+    if (depth > QJsonRpcWireFormat::MaximumDepth)
+        return false;
+
+    switch (reader.type()) {
+    case QCborStreamReader::UnsignedInteger:
+        *value = static_cast<double>(reader.toUnsignedInteger());
+        return reader.next();
+    case QCborStreamReader::NegativeInteger: {
+        // holds the absolute value, zero stands for -2^64
+        const quint64 magnitude = static_cast<quint64>(reader.toNegativeInteger());
+        *value = magnitude ? -static_cast<double>(magnitude) : -18446744073709551616.0;
+        return reader.next();
+    }
+    case QCborStreamReader::Float16:
+        *value = static_cast<double>(float(reader.toFloat16()));
+        return reader.next();
+    case QCborStreamReader::Float:
+        *value = static_cast<double>(reader.toFloat());
+        return reader.next();
+    case QCborStreamReader::Double:
+        *value = reader.toDouble();
+        return reader.next();
+    case QCborStreamReader::String: {
+        QString string;
+        if (!readCborString(reader, &string))
+            return false;
+        *value = string;
+        return true;
+    }
+    case QCborStreamReader::ByteArray: {
+        // JSON has no binary type, follow QCborValue::toJsonValue()
+        QByteArray bytes;
+        QCborStreamReader::StringResult<QByteArray> chunk = reader.readByteArray();
+        while (chunk.status == QCborStreamReader::Ok) {
+            bytes.append(chunk.data);
+            chunk = reader.readByteArray();
+        }
+        if (chunk.status != QCborStreamReader::EndOfString)
+            return false;
+        *value = QString::fromLatin1(bytes.toBase64(QByteArray::Base64UrlEncoding |
+                                                   QByteArray::OmitTrailingEquals));
+        return true;
+    }
+    case QCborStreamReader::Array: {
+        QJsonArray array;
+        if (!reader.enterContainer())
+            return false;
+        while (reader.hasNext()) {
+            QJsonValue element;
+            if (!readCborValue(reader, &element, depth + 1))
+                return false;
+            array.append(element);
+        }
+        if (reader.lastError() != QCborError::NoError || !reader.leaveContainer())
+            return false;
+        *value = array;
+        return true;
+    }
+    case QCborStreamReader::Map: {
+        QJsonObject object;
+        if (!reader.enterContainer())
+            return false;
+        while (reader.hasNext()) {
+            QString key;
+            QJsonValue element;
+            if (!reader.isString() || !readCborString(reader, &key) ||
+                !readCborValue(reader, &element, depth + 1))
+                return false;
+            object.insert(key, element);
+        }
+        if (reader.lastError() != QCborError::NoError || !reader.leaveContainer())
+            return false;
+        *value = object;
+        return true;
+    }
+    case QCborStreamReader::SimpleType:
+        if (reader.isTrue())
+            *value = true;
+        else if (reader.isFalse())
+            *value = false;
+        else if (reader.isNull())
+            *value = QJsonValue(QJsonValue::Null);
+        else
+            *value = QJsonValue(QJsonValue::Undefined);
+        return reader.next();
+    case QCborStreamReader::Tag:
+        // tags carry no meaning for the JSON model, decode the tagged item
+        return reader.next() && readCborValue(reader, value, depth + 1);
+    case QCborStreamReader::Invalid:
+        break;
+    }
+
+    return false;
+}
+
+bool QJsonRpcWireFormat::decodeCbor(const QByteArray &payload, QJsonObject *object)
+{
+    QCborStreamReader reader(payload);
+    if (!reader.isMap())
+        return false;
+
+    QJsonValue value;
+    if (!readCborValue(reader, &value, 0) || reader.lastError() != QCborError::NoError)
+        return false;
+
+    *object = value.toObject();
+    return true;
+}
+
+namespace {
+
+class MessagePackWriter
+{
+public:
+    explicit MessagePackWriter(QByteArray *output) : output(output) {}
+
+    void writeValue(const QJsonValue &value)
+    {
+        switch (value.type()) {
+        case QJsonValue::Null:
+        case QJsonValue::Undefined:
+            writeByte(0xc0);
+            break;
+        case QJsonValue::Bool:
+            writeByte(value.toBool() ? 0xc3 : 0xc2);
+            break;
+        case QJsonValue::Double:
+            writeNumber(value.toDouble());
+            break;
+        case QJsonValue::String:
+            writeString(value.toString());
+            break;
+        case QJsonValue::Array: {
+            const QJsonArray array = value.toArray();
+            writeContainerHeader(0x90, 0xdc, static_cast<quint32>(array.size()));
+            for (const QJsonValue &element : array)
+                writeValue(element);
+            break;
+        }
+        case QJsonValue::Object: {
+            const QJsonObject object = value.toObject();
+            writeContainerHeader(0x80, 0xde, static_cast<quint32>(object.size()));
+            for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+                writeString(it.key());
+                writeValue(it.value());
+            }
+            break;
+        }
+        }
+    }
+
+private:
+    void writeByte(uchar byte)
+    {
+        output->append(static_cast<char>(byte));
+    }
+
+    template <typename T>
+    void writeBigEndian(T value)
+    {
+        uchar bytes[sizeof(T)];
+        qToBigEndian<T>(value, bytes);
+        output->append(reinterpret_cast<const char *>(bytes), sizeof(T));
+    }
+
+    void writeNumber(double number)
+    {
+        if (number > -9007199254740992.0 && number < 9007199254740992.0 &&
+            number == static_cast<double>(static_cast<qint64>(number))) {
+            writeInteger(static_cast<qint64>(number));
+            return;
+        }
+
+        // single precision whenever it represents the value exactly
+        const float single = static_cast<float>(number);
+        if (static_cast<double>(single) == number) {
+            quint32 bits;
+            std::memcpy(&bits, &single, sizeof(bits));
+            writeByte(0xca);
+            writeBigEndian<quint32>(bits);
+        } else {
+            quint64 bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            writeByte(0xcb);
+            writeBigEndian<quint64>(bits);
+        }
+    }
+
+    void writeInteger(qint64 value)
+    {
+        if (value >= 0) {
+            if (value < 0x80) {
+                writeByte(static_cast<uchar>(value));
+            } else if (value <= 0xff) {
+                writeByte(0xcc);
+                writeByte(static_cast<uchar>(value));
+            } else if (value <= 0xffff) {
+                writeByte(0xcd);
+                writeBigEndian<quint16>(static_cast<quint16>(value));
+            } else if (value <= Q_INT64_C(0xffffffff)) {
+                writeByte(0xce);
+                writeBigEndian<quint32>(static_cast<quint32>(value));
+            } else {
+                writeByte(0xcf);
+                writeBigEndian<quint64>(static_cast<quint64>(value));
+            }
+        } else if (value >= -32) {
+            writeByte(static_cast<uchar>(value));
+        } else if (value >= -128) {
+            writeByte(0xd0);
+            writeByte(static_cast<uchar>(value));
+        } else if (value >= -32768) {
+            writeByte(0xd1);
+            writeBigEndian<quint16>(static_cast<quint16>(value));
+        } else if (value >= -Q_INT64_C(2147483648)) {
+            writeByte(0xd2);
+            writeBigEndian<quint32>(static_cast<quint32>(value));
+        } else {
+            writeByte(0xd3);
+            writeBigEndian<quint64>(static_cast<quint64>(value));
+        }
+    }
+
+    void writeString(const QString &string)
+    {
+        const QByteArray utf8 = string.toUtf8();
+        const quint32 size = static_cast<quint32>(utf8.size());
+        if (size < 32) {
+            writeByte(static_cast<uchar>(0xa0 | size));
+        } else if (size <= 0xff) {
+            writeByte(0xd9);
+            writeByte(static_cast<uchar>(size));
+        } else if (size <= 0xffff) {
+            writeByte(0xda);
+            writeBigEndian<quint16>(static_cast<quint16>(size));
+        } else {
+            writeByte(0xdb);
+            writeBigEndian<quint32>(size);
+        }
+        output->append(utf8);
+    }
+
+    // fixarray/fixmap below 16 entries, else the 16 or 32 bit variant
+    void writeContainerHeader(uchar fixed, uchar sized16, quint32 size)
+    {
+        if (size < 16) {
+            writeByte(static_cast<uchar>(fixed | size));
+        } else if (size <= 0xffff) {
+            writeByte(sized16);
+            writeBigEndian<quint16>(static_cast<quint16>(size));
+        } else {
+            writeByte(static_cast<uchar>(sized16 + 1));
+            writeBigEndian<quint32>(size);
+        }
+    }
+
+    QByteArray *output;
+};
+
+class MessagePackReader
+{
+public:
+    explicit MessagePackReader(const QByteArray &data)
+        : pos(reinterpret_cast<const uchar *>(data.constData())),
+          end(pos + data.size())
+    {}
+
+    bool atEnd() const { return pos == end; }
+
+    bool readValue(QJsonValue *value, int depth)
+    {
+        if (depth > QJsonRpcWireFormat::MaximumDepth || pos == end)
+            return false;
+
+        const uchar type = *pos++;
+        if (type < 0x80) {
+            *value = static_cast<double>(type);
+            return true;
+        } else if (type >= 0xe0) {
+            *value = static_cast<double>(static_cast<qint8>(type));
+            return true;
+        } else if ((type & 0xf0) == 0x80) {
+            return readMap(type & 0x0f, value, depth);
+        } else if ((type & 0xf0) == 0x90) {
+            return readArray(type & 0x0f, value, depth);
+        } else if ((type & 0xe0) == 0xa0) {
+            return readString(type & 0x1f, value);
+        }
+
+        quint64 raw = 0;
+        switch (type) {
+        case 0xc0:
+            *value = QJsonValue(QJsonValue::Null);
+            return true;
+        case 0xc2:
+            *value = false;
+            return true;
+        case 0xc3:
+            *value = true;
+            return true;
+        case 0xc4:
+        case 0xc5:
+        case 0xc6:
+            return readUnsigned(1 << (type - 0xc4), &raw) && readBinary(raw, value);
+        case 0xca: {
+            if (!readUnsigned(4, &raw))
+                return false;
+            const quint32 bits = static_cast<quint32>(raw);
+            float single;
+            std::memcpy(&single, &bits, sizeof(single));
+            *value = static_cast<double>(single);
+            return true;
+        }
+        case 0xcb: {
+            if (!readUnsigned(8, &raw))
+                return false;
+            double number;
+            std::memcpy(&number, &raw, sizeof(number));
+            *value = number;
+            return true;
+        }
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            if (!readUnsigned(1 << (type - 0xcc), &raw))
+                return false;
+            *value = static_cast<double>(raw);
+            return true;
+        case 0xd0:
+            if (!readUnsigned(1, &raw))
+                return false;
+            *value = static_cast<double>(static_cast<qint8>(raw));
+            return true;
+        case 0xd1:
+            if (!readUnsigned(2, &raw))
+                return false;
+            *value = static_cast<double>(static_cast<qint16>(raw));
+            return true;
+        case 0xd2:
+            if (!readUnsigned(4, &raw))
+                return false;
+            *value = static_cast<double>(static_cast<qint32>(raw));
+            return true;
+        case 0xd3:
+            if (!readUnsigned(8, &raw))
+                return false;
+            *value = static_cast<double>(static_cast<qint64>(raw));
+            return true;
+        case 0xd9:
+        case 0xda:
+        case 0xdb:
+            return readUnsigned(1 << (type - 0xd9), &raw) && readString(raw, value);
+        case 0xdc:
+        case 0xdd:
+            return readUnsigned(type == 0xdc ? 2 : 4, &raw) && readArray(raw, value, depth);
+        case 0xde:
+        case 0xdf:
+            return readUnsigned(type == 0xde ? 2 : 4, &raw) && readMap(raw, value, depth);
+        default:
+            // extension types have no JSON counterpart
+            break;
+        }
+
+        return false;
+    }
+
+private:
+    quint64 remaining() const { return static_cast<quint64>(end - pos); }
+
+    bool readUnsigned(int size, quint64 *value)
+    {
+        if (remaining() < static_cast<quint64>(size))
+            return false;
+
+        switch (size) {
+        case 1:
+            *value = *pos;
+            break;
+        case 2:
+            *value = qFromBigEndian<quint16>(pos);
+            break;
+        case 4:
+            *value = qFromBigEndian<quint32>(pos);
+            break;
+        default:
+            *value = qFromBigEndian<quint64>(pos);
+            break;
+        }
+
+        pos += size;
+        return true;
+    }
+
+    bool readString(quint64 size, QJsonValue *value)
+    {
+        if (remaining() < size)
+            return false;
+
+        *value = QString::fromUtf8(reinterpret_cast<const char *>(pos), static_cast<int>(size));
+        pos += size;
+        return true;
+    }
+
+    bool readBinary(quint64 size, QJsonValue *value)
+    {
+        if (remaining() < size)
+            return false;
+
+        // JSON has no binary type, same mapping as the CBOR decoder
+        const QByteArray bytes =
+            QByteArray::fromRawData(reinterpret_cast<const char *>(pos), static_cast<int>(size));
+        *value = QString::fromLatin1(bytes.toBase64(QByteArray::Base64UrlEncoding |
+                                                   QByteArray::OmitTrailingEquals));
+        pos += size;
+        return true;
+    }
+
+    bool readArray(quint64 size, QJsonValue *value, int depth)
+    {
+        // every element takes at least one byte
+        if (remaining() < size)
+            return false;
+
+        QJsonArray array;
+        for (quint64 i = 0; i < size; ++i) {
+            QJsonValue element;
+            if (!readValue(&element, depth + 1))
+                return false;
+            array.append(element);
+        }
+
+        *value = array;
+        return true;
+    }
+
+    bool readMap(quint64 size, QJsonValue *value, int depth)
+    {
+        if (remaining() < size * 2)
+            return false;
+
+        QJsonObject object;
+        for (quint64 i = 0; i < size; ++i) {
+            QJsonValue key;
+            QJsonValue element;
+            if (!readValue(&key, depth + 1) || !key.isString() ||
+                !readValue(&element, depth + 1))
+                return false;
+            object.insert(key.toString(), element);
+        }
+
+        *value = object;
+        return true;
+    }
+
+    const uchar *pos;
+    const uchar *end;
+};
+
+}
+
+void QJsonRpcWireFormat::encodeMessagePack(const QJsonObject &object, QByteArray *output)
+{
+    MessagePackWriter writer(output);
+    writer.writeValue(QJsonValue(object));
+}
+
+bool QJsonRpcWireFormat::decodeMessagePack(const QByteArray &payload, QJsonObject *object)
+{
+    MessagePackReader reader(payload);
+    QJsonValue value;
+    if (!reader.readValue(&value, 0) || !value.isObject() || !reader.atEnd())
+        return false;
+
+    *object = value.toObject();
+    return true;
+}
+
+void QJsonRpcWireFormat::encodeBinaryJson(const QJsonObject &object, QByteArray *output)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+QT_WARNING_PUSH
+QT_WARNING_DISABLE_DEPRECATED
+    // objects are kept in this layout already, encoding is a copy
+    output->append(QJsonDocument(object).toBinaryData());
+QT_WARNING_POP
+#else
+    Q_UNUSED(object)
+    Q_UNUSED(output)
+#endif
+}
+
+bool QJsonRpcWireFormat::decodeBinaryJson(const QByteArray &payload, QJsonObject *object)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    // validated once by Data::valid() and copied into an aligned block owned by
+    // the document. fromRawData() would avoid that copy, but values derived from
+    // the message can outlive the receive buffer it points into.
+QT_WARNING_PUSH
+QT_WARNING_DISABLE_DEPRECATED
+    const QJsonDocument document = QJsonDocument::fromBinaryData(payload, QJsonDocument::Validate);
+QT_WARNING_POP
+    if (!document.isObject())
+        return false;
+
+    *object = document.object();
+    return true;
+#else
+    Q_UNUSED(payload)
+    Q_UNUSED(object)
+    return false;
+#endif
+}
+
+bool QJsonRpcWireFormat::deflateWithDictionary(const char *data, int size, const QByteArray &dictionary,
+                                               QByteArray *output)
+{
+#if defined(QJSONRPC_HAVE_ZLIB)
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return false;
+
+    if (deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary.constData()),
+                             static_cast<uInt>(dictionary.size())) != Z_OK) {
+        deflateEnd(&stream);
+        return false;
+    }
+
+    const uLong bound = deflateBound(&stream, static_cast<uLong>(size));
+    output->resize(4 + static_cast<int>(bound));
+    qToBigEndian<quint32>(static_cast<quint32>(size), output->data());
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef *>(output->data() + 4);
+    stream.avail_out = static_cast<uInt>(bound);
+    const int result = deflate(&stream, Z_FINISH);
+    const uLong written = stream.total_out;
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        output->clear();
+        return false;
+    }
+
+    output->resize(4 + static_cast<int>(written));
+    return true;
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+    Q_UNUSED(dictionary)
+    Q_UNUSED(output)
+    return false;
+#endif
+}
+
+bool QJsonRpcWireFormat::readUncompressedSize(const QByteArray &payload, quint32 *size)
+{
+    if (payload.size() < 4)
+        return false;
+
+    *size = qFromBigEndian<quint32>(payload.constData());
+    return *size <= static_cast<quint32>(MaximumPayloadSize) &&
+           static_cast<quint64>(*size) <=
+               static_cast<quint64>(payload.size() - 4) * MaximumCompressionRatio;
+}
+
+bool QJsonRpcWireFormat::inflateWithDictionary(const QByteArray &payload, const QByteArray &dictionary,
+                                               QByteArray *output)
+{
+#if defined(QJSONRPC_HAVE_ZLIB)
+    quint32 size = 0;
+    if (!readUncompressedSize(payload, &size))
+        return false;
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK)
+        return false;
+
+    // one byte past the claimed size tells a longer stream from an exact fit
+    const quint32 capacity = size + 1;
+    output->resize(static_cast<int>(qMin<quint32>(capacity, InflateChunkSize)));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(payload.constData() + 4));
+    stream.avail_in = static_cast<uInt>(payload.size() - 4);
+
+    int result = Z_OK;
+    for (;;) {
+        stream.next_out = reinterpret_cast<Bytef *>(output->data()) + stream.total_out;
+        stream.avail_out = static_cast<uInt>(output->size()) - static_cast<uInt>(stream.total_out);
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_NEED_DICT) {
+            // the stream header names the dictionary by checksum, a different one is refused
+            if (dictionary.isEmpty() ||
+                inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary.constData()),
+                                     static_cast<uInt>(dictionary.size())) != Z_OK)
+                break;
+            continue;
+        }
+
+        if (result != Z_OK || stream.avail_out > 0 ||
+            static_cast<quint32>(output->size()) == capacity)
+            break;
+
+        output->resize(static_cast<int>(qMin<quint64>(static_cast<quint64>(output->size()) * 2,
+                                                        capacity)));
+    }
+
+    const bool complete = (result == Z_STREAM_END && stream.total_out == size);
+    inflateEnd(&stream);
+    if (complete)
+        output->resize(static_cast<int>(size));
+    else
+        output->clear();
+    return complete;
+#else
+    Q_UNUSED(payload)
+    Q_UNUSED(dictionary)
+    Q_UNUSED(output)
+    return false;
+#endif
+}
+
+quint32 QJsonRpcWireFormat::dictionaryId(const QByteArray &dictionary)
+{
+#if defined(QJSONRPC_HAVE_ZLIB)
+    if (dictionary.isEmpty())
+        return 0;
+
+    const uLong initial = adler32(0L, Z_NULL, 0);
+    return static_cast<quint32>(adler32(initial, reinterpret_cast<const Bytef *>(dictionary.constData()),
+                                        static_cast<uInt>(dictionary.size())));
+#else
+    Q_UNUSED(dictionary)
+    return 0;
+#endif
+}
+
+bool QJsonRpcWireFormat::readDictionaryId(const QByteArray &payload, quint32 *id)
+{
+    // the uncompressed size, then the zlib header: CMF, FLG with FDICT set and DICTID
+    if (payload.size() < 10)
+        return false;
+
+    const uchar cmf = static_cast<uchar>(payload.at(4));
+    const uchar flg = static_cast<uchar>(payload.at(5));
+    if ((cmf & 0x0f) != 8 || ((cmf << 8) | flg) % 31 != 0 || !(flg & 0x20))
+        return false;
+
+    *id = qFromBigEndian<quint32>(payload.constData() + 6);
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2012-2013 Matt Broadstone
+ * Contact: http://bitbucket.org/devonit/qjsonrpc
+ *
+ * This file is part of the QJsonRpc Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef QJSONRPCWIREFORMAT_P_H
+#define QJSONRPCWIREFORMAT_P_H
+
+#include <QByteArray>
+
+#if QT_VERSION >= 0x050000
+#include <QJsonObject>
+#else
+#include "json/qjsonobject.h"
+#endif
+
+#include "qjsonrpcsocket.h"
+#include "qjsonrpcglobal.h"
+
+/*
+ * Encoders and decoders for the framed wire formats of QJsonRpcSocket. Every
+ * frame starts with a big endian 32 bit header: the low 28 bits hold the
+ * payload length, the top 4 bits are reserved for frame flags.
+ */
+class QJSONRPC_EXPORT QJsonRpcWireFormat
+{
+public:
+    enum {
+        HeaderSize = 4,
+        MaximumPayloadSize = 0x0fffffff,
+        MaximumDepth = 1024,
+        MaximumDictionarySize = 32768,      // the deflate window
+        MaximumCompressionRatio = 1032,     // the most deflate can shrink data by
+        InflateChunkSize = 65536,           // initial output buffer of an inflate
+        MaximumAttachments = 1024           // per message
+    };
+
+    enum FrameFlag {
+        NoFlags = 0x0,
+        CompressedFrame = 0x1,      // payload went through qCompress()
+        DictionaryFrame = 0x2,      // payload deflated with the preset dictionary
+        AttachmentFrame = 0x4,      // raw attachment, belongs to the next message frame
+        KnownFlags = CompressedFrame | DictionaryFrame | AttachmentFrame
+    };
+
+    static bool isSupported(QJsonRpcSocket::WireFormat format);
+    static bool hasDictionarySupport();
+
+    // payloads larger than compressionThreshold bytes are compressed, -1 disables it;
+    // a non empty dictionary selects preset dictionary deflate over qCompress()
+    static QByteArray encodeFrame(QJsonRpcSocket::WireFormat format, const QJsonObject &object,
+                                  int compressionThreshold = -1,
+                                  const QByteArray &dictionary = QByteArray());
+    // same, the payload is encoded once per format and shared by the copies of
+    // message, so a broadcast isn't serialized again for every peer
+    static QByteArray encodeFrame(QJsonRpcSocket::WireFormat format, const QJsonRpcMessage &message,
+                                  int compressionThreshold = -1,
+                                  const QByteArray &dictionary = QByteArray());
+    // the uncompressed frame payload, empty for unframed formats
+    static QByteArray encodePayload(QJsonRpcSocket::WireFormat format, const QJsonObject &object);
+    static QByteArray buildFrame(const QByteArray &payload, int compressionThreshold,
+                                 const QByteArray &dictionary);
+    static bool decodeFrame(QJsonRpcSocket::WireFormat format, int flags, const QByteArray &payload,
+                            QJsonObject *object, const QByteArray &dictionary = QByteArray());
+    // header only, the data follows unchanged so large blobs aren't copied
+    static QByteArray attachmentHeader(int size);
+    static bool decodePayload(QJsonRpcSocket::WireFormat format, const QByteArray &payload,
+                              QJsonObject *object);
+
+    // parses the frame header at the start of data, returns false while incomplete
+    static bool readHeader(const QByteArray &data, int *flags, int *payloadSize);
+    static void writeHeader(QByteArray *frame, int flags);
+
+    static void encodeCbor(const QJsonObject &object, QByteArray *output);
+    static bool decodeCbor(const QByteArray &payload, QJsonObject *object);
+    static void encodeMessagePack(const QJsonObject &object, QByteArray *output);
+    static bool decodeMessagePack(const QByteArray &payload, QJsonObject *object);
+    static void encodeBinaryJson(const QJsonObject &object, QByteArray *output);
+    static bool decodeBinaryJson(const QByteArray &payload, QJsonObject *object);
+
+    // both prefix the data with its big endian uncompressed size like qCompress().
+    // The size is only trusted up to what the payload can inflate to, the
+    // output grows as data comes out of the stream.
+    static bool readUncompressedSize(const QByteArray &payload, quint32 *size);
+    static bool deflateWithDictionary(const char *data, int size, const QByteArray &dictionary,
+                                      QByteArray *output);
+    static bool inflateWithDictionary(const QByteArray &payload, const QByteArray &dictionary,
+                                      QByteArray *output);
+    // the adler32 checksum zlib names a preset dictionary by, 0 for none
+    static quint32 dictionaryId(const QByteArray &dictionary);
+    // reads the id of the dictionary a DictionaryFrame payload was deflated with
+    static bool readDictionaryId(const QByteArray &payload, quint32 *id);
+};
+
+#endif
@@ -15,6 +15,13 @@ DEFINES += QT_NO_NARROWING_CONVERSIONS_IN_CONNECT
 DEFINES += QT_USE_QSTRINGBUILDER
 DEFINES += QT_STRICT_ITERATORS
 CONFIG += ltcg
+
+# preset dictionary frame compression, optional
+packagesExist(zlib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+    DEFINES += QJSONRPC_HAVE_ZLIB
+}
 CONFIG += $${QJSONRPC_LIBRARY_TYPE}
 VERSION = $${QJSONRPC_VERSION}
 win32:DESTDIR = $$OUT_PWD
@@ -30,7 +37,9 @@ PRIVATE_HEADERS += \
     qjsonrpcsocket_p.h \
     qjsonrpcabstractserver_p.h \
     qjsonrpcservicereply_p.h \
-    qjsonrpchttpserver_p.h
+    qjsonrpchttpserver_p.h \
+    qjsonrpcobjectpool_p.h \
+    qjsonrpcwireformat_p.h
 
 INSTALL_HEADERS += \
     qjsonrpcmessage.h \
@@ -62,7 +71,8 @@ SOURCES += \
     qjsonrpcglobal.cpp \
     qjsonrpcservicereply.cpp \
     qjsonrpchttpclient.cpp \
-    qjsonrpchttpserver.cpp
+    qjsonrpchttpserver.cpp \
+    qjsonrpcwireformat.cpp
 
 # install
 headers.files = $${INSTALL_HEADERS}
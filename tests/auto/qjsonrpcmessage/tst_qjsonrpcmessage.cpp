@@ -44,6 +44,11 @@ private slots:
     void equivalence();
     void withVariantListArgs();
     void idSentAsString();
+    void variadicParameters();
+    void standardErrorResponses_data();
+    void standardErrorResponses();
+    void compactSerializationCached();
+    void attachments();
 };
 
 void TestQJsonRpcMessage::debugStreams_data()
@@ -334,5 +339,124 @@ void TestQJsonRpcMessage::idSentAsString()
     QCOMPARE(errorFromQJsonRpc, errorFromData);
 }
 
+void TestQJsonRpcMessage::variadicParameters()
+{
+    QStringList list = QStringList() << "a" << "b";
+    QJsonRpcMessage request =
+        QJsonRpcMessage::createRequest("service.method", 1, QLatin1String("two"), 3.5, true, list,
+                                       quint16(6), qint64(7), 8, 9, 10, QString("eleven"), 12u);
+    QCOMPARE(request.type(), QJsonRpcMessage::Request);
+
+    QJsonArray expected;
+    expected.append(1);
+    expected.append(QLatin1String("two"));
+    expected.append(3.5);
+    expected.append(true);
+    expected.append(QJsonArray::fromStringList(list));
+    expected.append(6);
+    expected.append(7);
+    expected.append(8);
+    expected.append(9);
+    expected.append(10);
+    expected.append(QLatin1String("eleven"));
+    expected.append(12);
+    QCOMPARE(request.params(), QJsonValue(expected));
+
+    QVariantMap map;
+    map.insert("key", 42);
+    QJsonRpcMessage notification = QJsonRpcMessage::createNotification("service.notify", map);
+    QCOMPARE(notification.type(), QJsonRpcMessage::Notification);
+    QCOMPARE(notification.params().toArray().at(0).toObject().value("key"), QJsonValue(42));
+}
+
+void TestQJsonRpcMessage::standardErrorResponses_data()
+{
+    QTest::addColumn<int>("code");
+    QTest::addColumn<QByteArray>("request");
+
+    QByteArray integerId("{\"jsonrpc\": \"2.0\", \"id\": 42, \"method\": \"service.method\"}");
+    QByteArray stringId("{\"jsonrpc\": \"2.0\", \"id\": \"a\\\"b\", \"method\": \"service.method\"}");
+    QByteArray fractionalId("{\"jsonrpc\": \"2.0\", \"id\": 1.5, \"method\": \"service.method\"}");
+    QByteArray noId("{\"jsonrpc\": \"2.0\", \"method\": \"service.method\"}");
+
+    QTest::newRow("parse-error") << int(QJsonRpc::ParseError) << integerId;
+    QTest::newRow("invalid-request") << int(QJsonRpc::InvalidRequest) << stringId;
+    QTest::newRow("method-not-found") << int(QJsonRpc::MethodNotFound) << integerId;
+    QTest::newRow("method-not-found-fractional-id") << int(QJsonRpc::MethodNotFound) << fractionalId;
+    QTest::newRow("invalid-params") << int(QJsonRpc::InvalidParams) << noId;
+    QTest::newRow("internal-error") << int(QJsonRpc::InternalError) << integerId;
+    QTest::newRow("server-busy") << int(QJsonRpc::ServerBusy) << stringId;
+}
+
+void TestQJsonRpcMessage::standardErrorResponses()
+{
+    QFETCH(int, code);
+    QFETCH(QByteArray, request);
+
+    QJsonRpcMessage message = QJsonRpcMessage::fromJson(request);
+    QJsonRpcMessage error =
+        message.createStandardErrorResponse(static_cast<QJsonRpc::ErrorCode>(code));
+    QCOMPARE(error.type(), QJsonRpcMessage::Error);
+    QCOMPARE(error.errorCode(), code);
+    QVERIFY(!error.errorMessage().isEmpty());
+    QCOMPARE(error.toObject().value("id"), message.toObject().contains("id") ?
+             message.toObject().value("id") : QJsonValue(0));
+
+    // the spliced serialization must describe the same message
+    QByteArray compact = error.toJson(QJsonDocument::Compact);
+    QCOMPARE(QJsonRpcMessage::fromJson(compact), error);
+    QCOMPARE(QJsonDocument::fromJson(compact).object(), error.toObject());
+}
+
+void TestQJsonRpcMessage::compactSerializationCached()
+{
+    QJsonRpcMessage notification =
+        QJsonRpcMessage::createNotification("service.notify", QLatin1String("payload"));
+    QJsonRpcMessage copy = notification;
+
+    QByteArray first = notification.toJson(QJsonDocument::Compact);
+    QByteArray second = copy.toJson(QJsonDocument::Compact);
+    QCOMPARE(first, QJsonDocument(notification.toObject()).toJson(QJsonDocument::Compact));
+    QVERIFY(first.constData() == second.constData());
+
+    // a copy detached for its attachment flag shares the bytes instead of copying them
+    QJsonRpcMessage detached = notification;
+    detached.setAcceptsAttachments(true);
+    QVERIFY(detached.toJson(QJsonDocument::Compact).constData() == first.constData());
+
+    // derived messages get their own serialization
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.method", 1, 2);
+    QByteArray requestJson = request.toJson(QJsonDocument::Compact);
+    QJsonRpcMessage response = request.createResponse(QJsonValue(3));
+    QVERIFY(response.toJson(QJsonDocument::Compact) != requestJson);
+    QCOMPARE(QJsonRpcMessage::fromJson(response.toJson(QJsonDocument::Compact)), response);
+}
+
+void TestQJsonRpcMessage::attachments()
+{
+    const QByteArray blob("\x00\x01\xfe\xff", 4);
+    QCOMPARE(QJsonRpcMessage::attachmentIndex(QJsonRpcMessage::attachmentReference(2)), 2);
+    QCOMPARE(QJsonRpcMessage::attachmentIndex(QJsonValue(2)), -1);
+
+    QJsonObject other;
+    other.insert(QLatin1String("$attachment"), 0);
+    other.insert(QLatin1String("name"), QLatin1String("not a reference"));
+    QCOMPARE(QJsonRpcMessage::attachmentIndex(other), -1);
+
+    QJsonRpcMessage request =
+        QJsonRpcMessage::createRequest("service.upload", QLatin1String("firmware.bin"),
+                                       QJsonRpcMessage::attachmentReference(0));
+    request.setAttachments(QList<QByteArray>() << blob);
+    QCOMPARE(request.attachments().size(), 1);
+    QCOMPARE(request.attachments().first(), blob);
+
+    // transports without attachment frames get the data inline
+    QJsonRpcMessage inlined = request.inlineAttachments();
+    QVERIFY(inlined.attachments().isEmpty());
+    QCOMPARE(inlined.params().toArray().at(0).toString(), QLatin1String("firmware.bin"));
+    QCOMPARE(inlined.params().toArray().at(1).toString(), QString::fromLatin1(blob.toBase64()));
+    QCOMPARE(request.params().toArray().at(1), QJsonRpcMessage::attachmentReference(0));
+}
+
 QTEST_MAIN(TestQJsonRpcMessage)
 #include "tst_qjsonrpcmessage.moc"
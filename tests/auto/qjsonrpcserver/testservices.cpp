@@ -16,6 +16,8 @@
  */
 #include <QEventLoop>
 #include <QTimer>
+#include <QThread>
+#include <QFutureInterface>
 #include <QDebug>
 #include <QtTest>
 
@@ -240,3 +242,106 @@ void TestDelayedResponseService::delayedResponseWithClosedSocketComplete()
     bool result = m_request.respond(responseMessage);
     Q_EMIT responseResult(result);
 }
+
+TestDeferredResponseService::TestDeferredResponseService(int expectedRequests, QObject *parent)
+    : QJsonRpcService(parent),
+      m_expectedRequests(expectedRequests)
+{
+}
+
+void TestDeferredResponseService::deferred(int value)
+{
+    beginDelayedResponse();
+    m_requests.append(qMakePair(currentRequest(), value));
+    if (m_requests.size() < m_expectedRequests)
+        return;
+
+    // answered in reverse, every request kept its own id and socket
+    while (!m_requests.isEmpty()) {
+        QPair<QJsonRpcServiceRequest, int> pending = m_requests.takeLast();
+        pending.first.respond(pending.second);
+    }
+}
+
+TestThreadPoolService::TestThreadPoolService(QObject *parent)
+    : QJsonRpcService(parent),
+      m_running(0)
+{
+}
+
+int TestThreadPoolService::running() const
+{
+    return m_running.loadAcquire();
+}
+
+bool TestThreadPoolService::calledFromSocket() const
+{
+    return qobject_cast<QJsonRpcSocket *>(currentRequest().socket()) != 0;
+}
+
+int TestThreadPoolService::sleep(int msecs)
+{
+    m_running.ref();
+    QThread::msleep(msecs);
+    m_running.deref();
+    return msecs;
+}
+
+TestFutureService::TestFutureService(QObject *parent)
+    : QJsonRpcService(parent)
+{
+}
+
+QFuture<int> TestFutureService::doubledLater(int value)
+{
+    QFutureInterface<int> promise;
+    promise.reportStarted();
+    QTimer::singleShot(50, this, [promise, value]() mutable {
+        promise.reportResult(value * 2);
+        promise.reportFinished();
+    });
+    return promise.future();
+}
+
+QFuture<int> TestFutureService::canceled()
+{
+    QFutureInterface<int> promise;
+    promise.reportStarted();
+    promise.reportCanceled();
+    promise.reportFinished();
+    return promise.future();
+}
+
+TestSingleFlightService::TestSingleFlightService(QObject *parent)
+    : QJsonRpcService(parent),
+      m_called(0),
+      m_fromSocket(0)
+{
+}
+
+int TestSingleFlightService::callCount() const
+{
+    return m_called.loadAcquire();
+}
+
+QThread *TestSingleFlightService::callThread() const
+{
+    return m_thread.loadAcquire();
+}
+
+bool TestSingleFlightService::calledFromSocket() const
+{
+    return m_fromSocket.loadAcquire() != 0;
+}
+
+void TestSingleFlightService::slowSquare(int value)
+{
+    m_called.ref();
+    m_thread.storeRelease(QThread::currentThread());
+    beginDelayedResponse();
+    QJsonRpcServiceRequest request = currentRequest();
+    m_fromSocket.storeRelease(qobject_cast<QJsonRpcSocket *>(request.socket()) ? 1 : 0);
+    QTimer::singleShot(200, this, [request, value]() mutable {
+        request.respond(value * value);
+    });
+}
@@ -17,8 +17,13 @@
 #ifndef TESTSERVICES_H
 #define TESTSERVICES_H
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QFuture>
+
 #include "qjsonrpcservice.h"
 
+class QThread;
 class TestService : public QJsonRpcService
 {
     Q_OBJECT
@@ -111,4 +116,73 @@ private:
 
 };
 
+class TestDeferredResponseService : public QJsonRpcService
+{
+    Q_OBJECT
+    Q_CLASSINFO("serviceName", "service")
+public:
+    TestDeferredResponseService(int expectedRequests, QObject *parent = 0);
+
+public Q_SLOTS:
+    void deferred(int value);
+
+private:
+    int m_expectedRequests;
+    QList<QPair<QJsonRpcServiceRequest, int> > m_requests;
+
+};
+
+class TestThreadPoolService : public QJsonRpcService
+{
+    Q_OBJECT
+    Q_CLASSINFO("serviceName", "service")
+    Q_CLASSINFO("concurrency", "threadpool")
+public:
+    TestThreadPoolService(QObject *parent = 0);
+    int running() const;
+
+public Q_SLOTS:
+    int sleep(int msecs);
+    bool calledFromSocket() const;
+
+private:
+    QAtomicInt m_running;       // calls inside sleep() on the pool
+
+};
+
+class TestFutureService : public QJsonRpcService
+{
+    Q_OBJECT
+    Q_CLASSINFO("serviceName", "service")
+public:
+    TestFutureService(QObject *parent = 0);
+
+public Q_SLOTS:
+    QFuture<int> doubledLater(int value);
+    QFuture<int> canceled();
+
+};
+
+class TestSingleFlightService : public QJsonRpcService
+{
+    Q_OBJECT
+    Q_CLASSINFO("serviceName", "service")
+    Q_CLASSINFO("singleflight", "slowSquare")
+public:
+    TestSingleFlightService(QObject *parent = 0);
+
+    int callCount() const;
+    QThread *callThread() const;    // of the last call
+    bool calledFromSocket() const;  // the last call saw the client's socket
+
+public Q_SLOTS:
+    void slowSquare(int value);
+
+private:
+    QAtomicInt m_called;        // counted on the server thread
+    QAtomicPointer<QThread> m_thread;
+    QAtomicInt m_fromSocket;
+
+};
+
 #endif  // TESTSERVICES_H
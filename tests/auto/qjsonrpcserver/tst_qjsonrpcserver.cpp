@@ -17,6 +17,7 @@
 #include <QLocalSocket>
 #include <QTcpSocket>
 #include <QScopedPointer>
+#include <QThreadPool>
 
 #include <QtCore/QEventLoop>
 #include <QtCore/QVariant>
@@ -35,6 +36,8 @@
 #include "qjsonrpchttpclient.h"
 #include "qjsonrpcsocket.h"
 #include "qjsonrpcmessage.h"
+#include "qjsonrpcmetatype.h"
+#include "qjsonrpcobjectpool_p.h"
 #include "qjsonrpcservicereply.h"
 #include "testservices.h"
 
@@ -70,6 +73,7 @@ private Q_SLOTS:
     void notifyConnectedClients();
     void numberParameters();
     void hugeResponse();
+    void pooledEnvelopes();
     void complexMethod();
     void defaultParameters();
     void overloadedMethod();
@@ -83,6 +87,11 @@ private Q_SLOTS:
     void userDeletesReplyOnDelayedResponse();
     void delayedResponseBasic();
     void delayedResponseSocketClosed();
+    void manyDelayedResponses();
+    void threadPoolDispatch();
+    void futureResults();
+    void singleFlight();
+    void concurrencyLimits();
 
     void addRemoveService();
     void serviceWithNoGivenName();
@@ -129,6 +138,7 @@ void TestQJsonRpcServer::initTestCase_data()
 
 void TestQJsonRpcServer::initTestCase()
 {
+    qRegisterJsonRpcFutureType<int>("QFuture<int>");
     serverThread.start();
 }
 
@@ -881,6 +891,273 @@ void TestQJsonRpcServer::delayedResponseSocketClosed()
     QCOMPARE(arguments.at(0).toBool(), false);
 }
 
+void TestQJsonRpcServer::manyDelayedResponses()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+    if (serverType == HttpServer) {
+#if QT_VERSION >= 0x050000
+        QSKIP("QNAM limits the number of outstanding requests");
+#else
+        QSKIP("QNAM limits the number of outstanding requests", SkipAll);
+#endif
+    }
+
+    const int count = 2000;
+    QVERIFY(server->addService(new TestDeferredResponseService(count)));
+    QJsonRpcServiceReplySpy spy(count);
+    connect(&spy, SIGNAL(finished()), &QTestEventLoop::instance(), SLOT(exitLoop()));
+
+    QHash<int, int> expectedResults;
+    for (int i = 0; i < count; ++i) {
+        QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.deferred", i);
+        QJsonRpcServiceReply *reply = clientSocket->sendMessage(request);
+        connect(reply, SIGNAL(finished()), &spy, SLOT(replyFinished()));
+        expectedResults.insert(request.id(), i);
+    }
+
+    QTestEventLoop::instance().enterLoop(10);
+    QVERIFY(!QTestEventLoop::instance().timeout());
+    QList<QJsonRpcMessage> responses = spy.responses();
+    QCOMPARE(responses.size(), count);
+    QCOMPARE(responses.first().result().toInt(), count - 1);
+    foreach (const QJsonRpcMessage &response, responses)
+        QCOMPARE(response.result().toInt(), expectedResults.value(response.id(), -1));
+}
+
+void TestQJsonRpcServer::threadPoolDispatch()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+    if (serverType == HttpServer) {
+#if QT_VERSION >= 0x050000
+        QSKIP("QNAM makes deterministic order impossible here");
+#else
+        QSKIP("QNAM makes deterministic order impossible here", SkipAll);
+#endif
+    }
+
+    TestThreadPoolService *service = new TestThreadPoolService;
+    QVERIFY(server->addService(service));
+    QCOMPARE(service->threadPool(), QThreadPool::globalInstance());
+
+    // the slow call must not hold back the one sent after it
+    QThreadPool pool;
+    pool.setMaxThreadCount(2);
+    service->setThreadPool(&pool);
+    QJsonRpcServiceReplySpy spy(2);
+    connect(&spy, SIGNAL(finished()), &QTestEventLoop::instance(), SLOT(exitLoop()));
+
+    QJsonRpcMessage slowRequest = QJsonRpcMessage::createRequest("service.sleep", 500);
+    QJsonRpcServiceReply *reply = clientSocket->sendMessage(slowRequest);
+    connect(reply, SIGNAL(finished()), &spy, SLOT(replyFinished()));
+    QJsonRpcMessage fastRequest = QJsonRpcMessage::createRequest("service.sleep", 0);
+    reply = clientSocket->sendMessage(fastRequest);
+    connect(reply, SIGNAL(finished()), &spy, SLOT(replyFinished()));
+
+    QTestEventLoop::instance().enterLoop(5);
+    QVERIFY(!QTestEventLoop::instance().timeout());
+    QList<QJsonRpcMessage> responses = spy.responses();
+    QCOMPARE(responses.at(0).id(), fastRequest.id());
+    QCOMPARE(responses.at(0).result().toInt(), 0);
+    QCOMPARE(responses.at(1).id(), slowRequest.id());
+    QCOMPARE(responses.at(1).result().toInt(), 500);
+
+    // the slot still sees the socket of the client, not the one relaying its response
+    QJsonRpcMessage response =
+        clientSocket->sendMessageBlocking(QJsonRpcMessage::createRequest("service.calledFromSocket"));
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QVERIFY(response.result().toBool());
+
+    // removing the service waits for its running calls, deleting it is safe then
+    clientSocket->sendMessage(QJsonRpcMessage::createRequest("service.sleep", 300));
+    QTRY_COMPARE(service->running(), 1);
+    QVERIFY(server->removeService(service));
+    QCOMPARE(service->running(), 0);
+    delete service;
+}
+
+void TestQJsonRpcServer::futureResults()
+{
+    QVERIFY(server->addService(new TestFutureService));
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.doubledLater", 21);
+    QJsonRpcMessage response = clientSocket->sendMessageBlocking(request);
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(request.id(), response.id());
+    QCOMPARE(response.result().toInt(), 42);
+
+    request = QJsonRpcMessage::createRequest("service.canceled");
+    response = clientSocket->sendMessageBlocking(request);
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InternalError));
+}
+
+void TestQJsonRpcServer::singleFlight()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+    if (serverType == HttpServer) {
+#if QT_VERSION >= 0x050000
+        QSKIP("QNAM makes the arrival of requests too unpredictable here");
+#else
+        QSKIP("QNAM makes the arrival of requests too unpredictable here", SkipAll);
+#endif
+    }
+
+    TestSingleFlightService *service = new TestSingleFlightService;
+    QVERIFY(server->addService(service));
+    QJsonRpcServiceReplySpy spy(6);
+    connect(&spy, SIGNAL(finished()), &QTestEventLoop::instance(), SLOT(exitLoop()));
+
+    // five identical calls share one execution, the sixth differs
+    QHash<int, int> expectedResults;
+    for (int i = 0; i < 6; ++i) {
+        const int value = i < 5 ? 3 : 4;
+        QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.slowSquare", value);
+        QJsonRpcServiceReply *reply = clientSocket->sendMessage(request);
+        connect(reply, SIGNAL(finished()), &spy, SLOT(replyFinished()));
+        expectedResults.insert(request.id(), value * value);
+    }
+
+    QTestEventLoop::instance().enterLoop(5);
+    QVERIFY(!QTestEventLoop::instance().timeout());
+    QCOMPARE(service->callCount(), 2);
+    // the flight only relays the response, the slot sees the client's socket
+    QVERIFY(service->calledFromSocket());
+    QList<QJsonRpcMessage> responses = spy.responses();
+    QCOMPARE(responses.size(), 6);
+    foreach (const QJsonRpcMessage &response, responses) {
+        QVERIFY(expectedResults.contains(response.id()));
+        QCOMPARE(response.result().toInt(), expectedResults.take(response.id()));
+    }
+
+    // once answered the next call runs again
+    QJsonRpcMessage response =
+        clientSocket->sendMessageBlocking(QJsonRpcMessage::createRequest("service.slowSquare", 3));
+    QCOMPARE(response.result().toInt(), 9);
+    QCOMPARE(service->callCount(), 3);
+
+    // flights of a removed service are not joined any more, the one in the
+    // air still answers its own request
+    QJsonRpcServiceReplySpy removedSpy(2);
+    connect(&removedSpy, SIGNAL(finished()), &QTestEventLoop::instance(), SLOT(exitLoop()));
+    QJsonRpcServiceReply *reply =
+        clientSocket->sendMessage(QJsonRpcMessage::createRequest("service.slowSquare", 7));
+    connect(reply, SIGNAL(finished()), &removedSpy, SLOT(replyFinished()));
+    QTRY_COMPARE(service->callCount(), 4);
+    QVERIFY(server->removeService(service));
+    QVERIFY(server->addService(service));
+    reply = clientSocket->sendMessage(QJsonRpcMessage::createRequest("service.slowSquare", 7));
+    connect(reply, SIGNAL(finished()), &removedSpy, SLOT(replyFinished()));
+    QTestEventLoop::instance().enterLoop(5);
+    QVERIFY(!QTestEventLoop::instance().timeout());
+    QCOMPARE(service->callCount(), 5);
+    foreach (const QJsonRpcMessage &answer, removedSpy.responses())
+        QCOMPARE(answer.result().toInt(), 49);
+}
+
+void TestQJsonRpcServer::concurrencyLimits()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+    if (serverType == HttpServer) {
+#if QT_VERSION >= 0x050000
+        QSKIP("QNAM makes the arrival of requests too unpredictable here");
+#else
+        QSKIP("QNAM makes the arrival of requests too unpredictable here", SkipAll);
+#endif
+    }
+
+    TestSingleFlightService *service = new TestSingleFlightService;
+    QVERIFY(server->addService(service));
+    server->setConcurrencyLimit(QLatin1String("service.slowSquare"), 1, 2);
+    QJsonRpcServiceReplySpy spy(4);
+    connect(&spy, SIGNAL(finished()), &QTestEventLoop::instance(), SLOT(exitLoop()));
+
+    // one call runs, two wait and the fourth is turned away
+    QHash<int, int> requestValues;
+    for (int value = 1; value <= 4; ++value) {
+        QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.slowSquare", value);
+        QJsonRpcServiceReply *reply = clientSocket->sendMessage(request);
+        connect(reply, SIGNAL(finished()), &spy, SLOT(replyFinished()));
+        requestValues.insert(request.id(), value);
+    }
+
+    QTRY_COMPARE(server->queuedCount(QLatin1String("service.slowSquare")), 2);
+    QCOMPARE(server->inFlightCount(QLatin1String("service.slowSquare")), 1);
+
+    QTestEventLoop::instance().enterLoop(5);
+    QVERIFY(!QTestEventLoop::instance().timeout());
+    QCOMPARE(service->callCount(), 3);
+    // admitted calls answer through a stand-in, the slot still sees the client
+    QVERIFY(service->calledFromSocket());
+    QList<QJsonRpcMessage> responses = spy.responses();
+    QCOMPARE(responses.size(), 4);
+    foreach (const QJsonRpcMessage &response, responses) {
+        const int value = requestValues.value(response.id());
+        if (value == 4) {
+            QCOMPARE(response.type(), QJsonRpcMessage::Error);
+            QCOMPARE(response.errorCode(), int(QJsonRpc::ServerBusy));
+        } else {
+            QCOMPARE(response.result().toInt(), value * value);
+        }
+    }
+
+    QCOMPARE(server->inFlightCount(QLatin1String("service.slowSquare")), 0);
+    QCOMPARE(server->queuedCount(QLatin1String("service.slowSquare")), 0);
+
+    // removing the limit lets the waiting calls go ahead on the server thread
+    server->setConcurrencyLimit(QLatin1String("service.slowSquare"), 0, 2);
+    QJsonRpcServiceReplySpy waitingSpy(2);
+    connect(&waitingSpy, SIGNAL(finished()), &QTestEventLoop::instance(), SLOT(exitLoop()));
+    for (int value = 5; value <= 6; ++value) {
+        QJsonRpcServiceReply *reply =
+            clientSocket->sendMessage(QJsonRpcMessage::createRequest("service.slowSquare", value));
+        connect(reply, SIGNAL(finished()), &waitingSpy, SLOT(replyFinished()));
+    }
+
+    QTRY_COMPARE(server->queuedCount(QLatin1String("service.slowSquare")), 2);
+    QCOMPARE(service->callCount(), 3);
+    server->setConcurrencyLimit(QLatin1String("service.slowSquare"), -1);
+    QTestEventLoop::instance().enterLoop(5);
+    QVERIFY(!QTestEventLoop::instance().timeout());
+    QCOMPARE(service->callCount(), 5);
+    QCOMPARE(service->callThread(), &serverThread);
+    foreach (const QJsonRpcMessage &response, waitingSpy.responses())
+        QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(server->queuedCount(QLatin1String("service.slowSquare")), 0);
+}
+
+void TestQJsonRpcServer::pooledEnvelopes()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+    if (serverType == HttpServer) {
+#if QT_VERSION >= 0x050000
+        QSKIP("replies of the http client are released from the event loop");
+#else
+        QSKIP("replies of the http client are released from the event loop", SkipAll);
+#endif
+    }
+
+    QVERIFY(server->addService(new TestService));
+
+    // warm up the free lists of this thread, the server has its own
+    for (int i = 0; i < 10; ++i) {
+        QJsonRpcMessage response =
+            clientSocket->sendMessageBlocking(QJsonRpcMessage::createRequest("service.noParam"));
+        QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    }
+
+    // requests, replies and the responses read off the socket all reuse blocks
+    QJsonRpcObjectPoolStatistics &statistics = qJsonRpcObjectPoolStatistics();
+    statistics.heapAllocations = 0;
+    statistics.pooledAllocations = 0;
+    for (int i = 0; i < 50; ++i) {
+        QJsonRpcMessage response =
+            clientSocket->sendMessageBlocking(QJsonRpcMessage::createRequest("service.noParam"));
+        QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    }
+
+    QCOMPARE(statistics.heapAllocations, quint64(0));
+    QVERIFY(statistics.pooledAllocations >= 50 * 3);
+}
+
 void TestQJsonRpcServer::addRemoveService()
 {
     TestService service;
@@ -897,6 +1174,12 @@ void TestQJsonRpcServer::addRemoveService()
     response = clientSocket->sendMessageBlocking(request);
     QVERIFY(response.errorCode() == QJsonRpc::MethodNotFound);
 
+    // routing must follow the service being registered again
+    QVERIFY(server->addService(&service));
+    response = clientSocket->sendMessageBlocking(request);
+    QVERIFY(response.errorCode() == QJsonRpc::NoError);
+    QVERIFY(server->removeService(&service));
+
     QFETCH_GLOBAL(ServerType, serverType);
     if (serverType == TcpServer)
         QVERIFY(tcpServer->errorString().isEmpty());
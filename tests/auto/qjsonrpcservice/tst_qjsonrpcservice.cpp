@@ -26,16 +26,50 @@
 #include "qjsonrpcabstractserver.h"
 #include "qjsonrpcmessage.h"
 #include "qjsonrpcservice.h"
+#include "qjsonrpcservicereply.h"
+#include "qjsonrpcobjectpool_p.h"
+
+struct UserId
+{
+    UserId() : value(0) {}
+    int value;
+};
+Q_DECLARE_METATYPE(UserId)
+
+struct Tag
+{
+    QString name;
+};
+Q_DECLARE_METATYPE(Tag)
+
+// registered, but nothing converts to it
+struct Opaque
+{
+    int value;
+};
+Q_DECLARE_METATYPE(Opaque)
 
 class TestQJsonRpcService: public QObject
 {
     Q_OBJECT
 private slots:
+    void initTestCase();
     void dispatch_data();
     void dispatch();
     void ambiguousDispatch();
+    void cachedOverloadResolution();
     void dispatchSignals_data();
     void dispatchSignals();
+    void pooledEnvelopes();
+    void manyParameters();
+    void manyNamedParameters();
+    void returnValues_data();
+    void returnValues();
+    void argumentConversions_data();
+    void argumentConversions();
+    void byteArrayResults();
+    void typedMethods();
+    void cachedResults();
 
 };
 
@@ -43,12 +77,14 @@ class TestService : public QJsonRpcService
 {
     Q_OBJECT
     Q_CLASSINFO("serviceName", "service")
+    Q_CLASSINFO("cache.cachedSquare", "60000,16")
 public:
     TestService(QObject *parent = 0)
         : QJsonRpcService(parent),
           m_stringCount(0),
           m_intCount(0),
-          m_variantCount(0)
+          m_variantCount(0),
+          m_squareCount(0)
     {}
 
     QJsonRpcMessage testDispatch(const QJsonRpcMessage &message) {
@@ -58,6 +94,7 @@ public:
     int stringCount() const { return m_stringCount; }
     int intCount() const { return m_intCount; }
     int variantCount() const { return m_variantCount; }
+    int squareCount() const { return m_squareCount; }
     void resetCounters() { m_stringCount = m_intCount = m_variantCount = 0; }
 
 Q_SIGNALS:
@@ -82,10 +119,44 @@ public Q_SLOTS:
         m_variantCount++;
     }
 
+    int sum(int a, int b, int c, int d, int e, int f, int g, int h, int i, int j, int k, int l) const {
+        return a + b + c + d + e + f + g + h + i + j + k + l;
+    }
+
+    bool returnBool() const { return true; }
+    double returnDouble() const { return 2.5; }
+    QStringList returnStringList() const { return QStringList() << "a" << "b"; }
+    QVariantMap returnVariantMap() const {
+        QVariantMap map;
+        map.insert("key", 1);
+        return map;
+    }
+    QJsonObject returnObject() const {
+        QJsonObject object;
+        object.insert("key", QLatin1String("value"));
+        return object;
+    }
+    QVariant returnVariant() const { return QVariant(QLatin1String("variant")); }
+    QByteArray returnBytes() const { return QByteArray("bytes"); }
+
+    int userId(const UserId &id) const { return id.value; }
+    QString tag(const Tag &tag) const { return tag.name; }
+    int opaque(const Opaque &opaque) const { return opaque.value; }
+    int shortValue(short value) const { return value; }
+    QString url(const QUrl &url) const { return url.host(); }
+    QString point(const QPoint &point) const { return QString::number(point.x()); }
+    void returnNothing() {}
+
+    int cachedSquare(int value) {
+        m_squareCount++;
+        return value * value;
+    }
+
 private:
     int m_stringCount;
     int m_intCount;
     int m_variantCount;
+    int m_squareCount;
 
 };
 
@@ -95,6 +166,23 @@ public:
     TestServiceProvider() {}
 };
 
+void TestQJsonRpcService::initTestCase()
+{
+    qRegisterMetaType<UserId>("UserId");
+    qRegisterMetaType<Tag>("Tag");
+    qRegisterMetaType<Opaque>("Opaque");
+    QMetaType::registerConverter<QJsonValue, UserId>([](const QJsonValue &value) {
+        UserId id;
+        id.value = value.toInt();
+        return id;
+    });
+    QMetaType::registerConverter<QString, Tag>([](const QString &name) {
+        Tag tag;
+        tag.name = name;
+        return tag;
+    });
+}
+
 void TestQJsonRpcService::dispatch_data()
 {
     QTest::addColumn<QJsonRpcMessage>("request");
@@ -187,6 +275,34 @@ void TestQJsonRpcService::ambiguousDispatch()
     QCOMPARE(service.variantCount(), 1);
 }
 
+void TestQJsonRpcService::cachedOverloadResolution()
+{
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    // the second round is served from the overload cache
+    for (int round = 1; round <= 2; ++round) {
+        service.testDispatch(QJsonRpcMessage::createRequest("service.ambiguousMethod", 10));
+        service.testDispatch(QJsonRpcMessage::createRequest("service.ambiguousMethod", QLatin1String("test")));
+        service.testDispatch(QJsonRpcMessage::createRequest("service.ambiguousMethod", 10));
+        QCOMPARE(service.intCount(), 2 * round);
+        QCOMPARE(service.stringCount(), round);
+        QCOMPARE(service.variantCount(), 0);
+
+        QJsonObject named;
+        named.insert(QLatin1String("string"), QLatin1String("testParam"));
+        QJsonRpcMessage response =
+            service.testDispatch(QJsonRpcMessage::createRequest("service.testMethod", named));
+        QCOMPARE(response.result().toString(), QLatin1String("testParam"));
+
+        QJsonObject mismatched;
+        mismatched.insert(QLatin1String("string"), 10);
+        response = service.testDispatch(QJsonRpcMessage::createRequest("service.testMethod", mismatched));
+        QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    }
+}
+
 void TestQJsonRpcService::dispatchSignals_data()
 {
     QTest::addColumn<QJsonRpcMessage>("request");
@@ -225,5 +341,307 @@ void TestQJsonRpcService::dispatchSignals()
     QCOMPARE(response.type(), messageType);
 }
 
+static bool envelopeRoundTrip(TestService *service)
+{
+    QJsonRpcMessage request =
+        QJsonRpcMessage::createRequest("service.testMethod", QLatin1String("testParam"));
+    QJsonRpcServiceRequest serviceRequest(request, 0);
+    QScopedPointer<QJsonRpcServiceReply> reply(new QJsonRpcServiceReply);
+    QJsonRpcMessage response = service->testDispatch(serviceRequest.request());
+    return response.type() == QJsonRpcMessage::Response;
+}
+
+void TestQJsonRpcService::pooledEnvelopes()
+{
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    // warm up the per-thread free lists
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(envelopeRoundTrip(&service));
+
+    QJsonRpcObjectPoolStatistics &statistics = qJsonRpcObjectPoolStatistics();
+    statistics.heapAllocations = 0;
+    statistics.pooledAllocations = 0;
+    for (int i = 0; i < 100; ++i)
+        QVERIFY(envelopeRoundTrip(&service));
+
+    QCOMPARE(statistics.heapAllocations, quint64(0));
+    QVERIFY(statistics.pooledAllocations >= 100 * 4);
+}
+
+void TestQJsonRpcService::manyParameters()
+{
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    // more than the ten arguments QMetaObject::invokeMethod can pass
+    QJsonRpcMessage request =
+        QJsonRpcMessage::createRequest("service.sum", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12);
+    QJsonRpcMessage response = service.testDispatch(request);
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(response.result().toInt(), 78);
+}
+
+void TestQJsonRpcService::manyNamedParameters()
+{
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    // unknown keys are ignored, every parameter is bound by name
+    QJsonObject named;
+    const QString names = QLatin1String("lkjihgfedcba");
+    for (int i = 0; i < names.size(); ++i)
+        named.insert(QString(names.at(i)), 1 << i);
+    named.insert(QLatin1String("unused"), 1000);
+    QJsonRpcMessage response =
+        service.testDispatch(QJsonRpcMessage::createRequest("service.sum", named));
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(response.result().toInt(), (1 << 12) - 1);
+}
+
+void TestQJsonRpcService::returnValues_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<QJsonValue>("expected");
+
+    QJsonObject object;
+    object.insert("key", QLatin1String("value"));
+    QJsonObject map;
+    map.insert("key", 1);
+    QTest::newRow("bool") << "service.returnBool" << QJsonValue(true);
+    QTest::newRow("double") << "service.returnDouble" << QJsonValue(2.5);
+    QTest::newRow("stringlist") << "service.returnStringList"
+                                << QJsonValue(QJsonArray::fromStringList(QStringList() << "a" << "b"));
+    QTest::newRow("variantmap") << "service.returnVariantMap" << QJsonValue(map);
+    QTest::newRow("object") << "service.returnObject" << QJsonValue(object);
+    QTest::newRow("variant") << "service.returnVariant" << QJsonValue(QLatin1String("variant"));
+    QTest::newRow("void") << "service.returnNothing" << QJsonValue();
+}
+
+void TestQJsonRpcService::returnValues()
+{
+    QFETCH(QString, method);
+    QFETCH(QJsonValue, expected);
+
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    QJsonRpcMessage response = service.testDispatch(QJsonRpcMessage::createRequest(method));
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(response.result(), expected);
+}
+
+void TestQJsonRpcService::argumentConversions_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<QJsonValue>("argument");
+    QTest::addColumn<QJsonValue>("expected");  // undefined when the call is refused
+
+    // user types convert from the JSON value or from its plain form
+    QTest::newRow("user-type-from-json") << "service.userId" << QJsonValue(42) << QJsonValue(42);
+    QTest::newRow("user-type-from-string") << "service.tag" << QJsonValue(QLatin1String("red"))
+                                           << QJsonValue(QLatin1String("red"));
+    QTest::newRow("builtin-from-string") << "service.url" << QJsonValue(QLatin1String("http://example.com/"))
+                                         << QJsonValue(QLatin1String("example.com"));
+    QTest::newRow("builtin-from-number") << "service.shortValue" << QJsonValue(12) << QJsonValue(12);
+
+    // nothing is passed on that isn't of the parameter type
+    QTest::newRow("user-type-without-converter") << "service.tag" << QJsonValue(5)
+                                                 << QJsonValue(QJsonValue::Undefined);
+    QTest::newRow("unconvertible-user-type") << "service.opaque" << QJsonValue(5)
+                                             << QJsonValue(QJsonValue::Undefined);
+    QTest::newRow("unconvertible-builtin") << "service.point" << QJsonValue(QLatin1String("1,2"))
+                                           << QJsonValue(QJsonValue::Undefined);
+}
+
+void TestQJsonRpcService::argumentConversions()
+{
+    QFETCH(QString, method);
+    QFETCH(QJsonValue, argument);
+    QFETCH(QJsonValue, expected);
+
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    QJsonRpcMessage response =
+        service.testDispatch(QJsonRpcMessage::createRequest(method, argument));
+    if (expected.isUndefined()) {
+        QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    } else {
+        QCOMPARE(response.type(), QJsonRpcMessage::Response);
+        QCOMPARE(response.result(), expected);
+    }
+}
+
+class Accumulator
+{
+public:
+    Accumulator() : m_total(0) {}
+    qint64 add(qint64 value) { m_total += value; return m_total; }
+    QStringList split(const QString &string) const { return string.split(QLatin1Char(',')); }
+
+private:
+    qint64 m_total;
+};
+
+void TestQJsonRpcService::byteArrayResults()
+{
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    // requests from JSON transports get the data as a string
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.returnBytes");
+    QJsonRpcMessage response = service.testDispatch(request);
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(response.result(), QJsonValue(QLatin1String("bytes")));
+    QVERIFY(response.attachments().isEmpty());
+
+    // framed transports get it as an attachment
+    request.setAcceptsAttachments(true);
+    response = service.testDispatch(request);
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(response.result(), QJsonRpcMessage::attachmentReference(0));
+    QCOMPARE(response.attachments(), QList<QByteArray>() << QByteArray("bytes"));
+}
+
+void TestQJsonRpcService::typedMethods()
+{
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    QVERIFY(service.registerMethod("add", [](int a, int b) { return a + b; },
+                                   QStringList() << "a" << "b"));
+    QJsonRpcMessage response =
+        service.testDispatch(QJsonRpcMessage::createRequest("service.add", 2, 3));
+    QCOMPARE(response.type(), QJsonRpcMessage::Response);
+    QCOMPARE(response.result().toInt(), 5);
+
+    QJsonObject named;
+    named.insert(QLatin1String("b"), 10);
+    named.insert(QLatin1String("a"), 1);
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", named));
+    QCOMPARE(response.result().toInt(), 11);
+
+    // missing trailing arguments are default constructed, extra ones are refused
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", 2));
+    QCOMPARE(response.result().toInt(), 2);
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", 1, 2, 3));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    response = service.testDispatch(
+        QJsonRpcMessage::createRequest("service.add", QLatin1String("1"), 2));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+
+    // integers have to be whole and in range, nothing is rounded or wrapped
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", 2.5, 1));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", 1e30, 1));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", 2147483648.0, 0));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", -2147483648.0, 0));
+    QCOMPARE(response.result().toDouble(), -2147483648.0);
+    QVERIFY(service.registerMethod("unsignedValue", [](uint value) { return value; }));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.unsignedValue", -1));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.unsignedValue", 4294967295.0));
+    QCOMPARE(response.result().toDouble(), 4294967295.0);
+    QVERIFY(service.registerMethod("longValue", [](qint64 value) { return value; }));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.longValue", 9223372036854775808.0));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+
+    Accumulator accumulator;
+    QVERIFY(service.registerMethod("accumulate", &accumulator, &Accumulator::add));
+    QVERIFY(service.registerMethod("split", &accumulator, &Accumulator::split));
+    service.testDispatch(QJsonRpcMessage::createRequest("service.accumulate", 40));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.accumulate", 2));
+    QCOMPARE(response.result().toInt(), 42);
+    response = service.testDispatch(
+        QJsonRpcMessage::createRequest("service.split", QLatin1String("a,b")));
+    QCOMPARE(response.result(), QJsonValue(QJsonArray::fromStringList(QStringList() << "a" << "b")));
+
+    // without parameter names only positional parameters bind
+    named = QJsonObject();
+    named.insert(QLatin1String("value"), 1);
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.accumulate", named));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::InvalidParams));
+    QVERIFY(!service.registerMethod("bad", [](int) {}, QStringList() << "a" << "b"));
+
+    // registered methods shadow slots until they are removed again
+    QVERIFY(service.registerMethod("returnBool", []() { return false; }));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.returnBool"));
+    QCOMPARE(response.result(), QJsonValue(false));
+    QVERIFY(service.unregisterMethod("returnBool"));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.returnBool"));
+    QCOMPARE(response.result(), QJsonValue(true));
+
+    QVERIFY(service.unregisterMethod("add"));
+    QVERIFY(!service.unregisterMethod("add"));
+    response = service.testDispatch(QJsonRpcMessage::createRequest("service.add", 2, 3));
+    QCOMPARE(response.errorCode(), int(QJsonRpc::MethodNotFound));
+}
+
+void TestQJsonRpcService::cachedResults()
+{
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    // set up through the class info
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.cachedSquare", 3);
+    QCOMPARE(service.testDispatch(request).result().toInt(), 9);
+    QJsonRpcMessage response = service.testDispatch(request);
+    QCOMPARE(response.result().toInt(), 9);
+    QCOMPARE(response.id(), request.id());
+    QCOMPARE(service.squareCount(), 1);
+    QCOMPARE(service.cacheStatistics("cachedSquare").hits, quint64(1));
+    QCOMPARE(service.cacheStatistics("cachedSquare").misses, quint64(1));
+
+    // every request still gets its own id
+    QJsonRpcMessage other = QJsonRpcMessage::createRequest("service.cachedSquare", 3);
+    QCOMPARE(service.testDispatch(other).id(), other.id());
+    QCOMPARE(service.squareCount(), 1);
+
+    // the least recently used result is dropped first
+    service.setResultCaching("cachedSquare", -1, 2);
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 3));
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 4));
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 3));
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 5));
+    QCOMPARE(service.squareCount(), 4);
+    QCOMPARE(service.cacheStatistics("cachedSquare").entries, 2);
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 3));
+    QCOMPARE(service.squareCount(), 4);
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 4));
+    QCOMPARE(service.squareCount(), 5);
+
+    service.invalidateCachedResults("cachedSquare");
+    QCOMPARE(service.cacheStatistics("cachedSquare").entries, 0);
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 4));
+    QCOMPARE(service.squareCount(), 6);
+
+    // expired results are computed again
+    service.setResultCaching("cachedSquare", 50);
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 6));
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 6));
+    QCOMPARE(service.squareCount(), 7);
+    QTest::qWait(100);
+    service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare", 6));
+    QCOMPARE(service.squareCount(), 8);
+
+    // errors are not cached
+    QCOMPARE(service.testDispatch(QJsonRpcMessage::createRequest("service.cachedSquare",
+                                                                 QLatin1String("6"))).errorCode(),
+             int(QJsonRpc::InvalidParams));
+    QCOMPARE(service.cacheStatistics("cachedSquare").entries, 1);
+}
+
 QTEST_MAIN(TestQJsonRpcService)
 #include "tst_qjsonrpcservice.moc"
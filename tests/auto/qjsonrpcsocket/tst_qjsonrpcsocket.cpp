@@ -33,6 +33,7 @@
 #include "qjsonrpcservicereply.h"
 #include "qjsonrpcsocket_p.h"
 #include "qjsonrpcsocket.h"
+#include "qjsonrpcwireformat_p.h"
 
 class QBufferBackedQJsonRpcSocketPrivate : public QJsonRpcSocketPrivate
 {
@@ -76,9 +77,18 @@ private Q_SLOTS:
     void initTestCase_data();
     void noParameters();
     void multiParameter();
+    void variadicParameters();
     void notification();
     void response();
     void delayedMessageReceive();
+    void framedWireFormats_data();
+    void framedWireFormats();
+    void binaryJsonAvailability();
+    void messagePackEncoding();
+    void compressedFrames();
+    void dictionaryCompressedFrames();
+    void dictionaryMismatch();
+    void attachmentFrames();
 
 private:
     // benchmark parsing speed
@@ -159,6 +169,25 @@ void TestQJsonRpcSocket::multiParameter()
     QCOMPARE(spyMessageReceived.count(), 0);
 }
 
+void TestQJsonRpcSocket::variadicParameters()
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    QJsonRpcSocket serviceSocket(&buffer, this);
+    QVERIFY(serviceSocket.isValid());
+
+    QScopedPointer<QJsonRpcServiceReply> reply(
+        serviceSocket.invoke("test.variadic", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, QString("twelve")));
+    QJsonRpcMessage request = reply->request();
+    QCOMPARE(request.params().toArray().size(), 12);
+    QCOMPARE(request.params().toArray().last(), QJsonValue(QLatin1String("twelve")));
+
+    QJsonRpcMessage bufferMessage = QJsonRpcMessage::fromJson(buffer.data());
+    QCOMPARE(request.id(), bufferMessage.id());
+    QCOMPARE(request.method(), bufferMessage.method());
+    QCOMPARE(request.params(), bufferMessage.params());
+}
+
 void TestQJsonRpcSocket::notification()
 {
     QFETCH_GLOBAL(InvokeType, invokeType);
@@ -265,5 +294,331 @@ void TestQJsonRpcSocket::delayedMessageReceive()
         qApp->processEvents();
 }
 
+void TestQJsonRpcSocket::framedWireFormats_data()
+{
+    QTest::addColumn<int>("wireFormat");
+    QTest::newRow("cbor") << int(QJsonRpcSocket::CborWireFormat);
+    QTest::newRow("msgpack") << int(QJsonRpcSocket::MessagePackWireFormat);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QTest::newRow("binaryjson") << int(QJsonRpcSocket::BinaryJsonWireFormat);
+#endif
+    QTest::newRow("framedjson") << int(QJsonRpcSocket::FramedJsonWireFormat);
+}
+
+void TestQJsonRpcSocket::binaryJsonAvailability()
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    QJsonRpcSocket socket(&buffer, this);
+    socket.setWireFormat(QJsonRpcSocket::BinaryJsonWireFormat);
+
+    QJsonObject object;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // the binary representation is gone with Qt 6, the socket keeps its format
+    QVERIFY(!QJsonRpcWireFormat::isSupported(QJsonRpcSocket::BinaryJsonWireFormat));
+    QCOMPARE(socket.wireFormat(), QJsonRpcSocket::JsonWireFormat);
+    QVERIFY(!QJsonRpcWireFormat::decodePayload(QJsonRpcSocket::BinaryJsonWireFormat,
+                                               QByteArray("qbjs\x01\x00\x00\x00", 8), &object));
+#else
+    QVERIFY(QJsonRpcWireFormat::isSupported(QJsonRpcSocket::BinaryJsonWireFormat));
+    QCOMPARE(socket.wireFormat(), QJsonRpcSocket::BinaryJsonWireFormat);
+    QVERIFY(!QJsonRpcWireFormat::decodePayload(QJsonRpcSocket::BinaryJsonWireFormat,
+                                               QByteArray("not binary json"), &object));
+#endif
+}
+
+void TestQJsonRpcSocket::framedWireFormats()
+{
+    QFETCH(int, wireFormat);
+
+    QBuffer outgoing;
+    outgoing.open(QIODevice::ReadWrite);
+    QJsonRpcSocket sender(&outgoing, this);
+    sender.setWireFormat(static_cast<QJsonRpcSocket::WireFormat>(wireFormat));
+    QCOMPARE(int(sender.wireFormat()), wireFormat);
+
+    QJsonObject nested;
+    nested.insert("three", 3);
+    QJsonArray list;
+    list.append(1);
+    list.append(QLatin1String("two"));
+    list.append(nested);
+
+    QJsonObject named;
+    named.insert("integer", -42);
+    named.insert("large", 4294967296.0);
+    named.insert("fraction", 0.5);
+    named.insert("text", QString::fromUtf8("h\xc3\xa9llo"));
+    named.insert("flag", true);
+    named.insert("nothing", QJsonValue());
+    named.insert("list", list);
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest("test.framed", named);
+    QJsonRpcMessage notification = QJsonRpcMessage::createNotification("test.notify", list);
+    sender.notify(request);
+    sender.notify(notification);
+
+    // a malformed frame must be skipped without losing the following ones
+    QByteArray wire("\x00\x00\x00\x03\xff\xff\xff", 7);
+    wire.append(outgoing.data());
+
+    QBuffer incoming;
+    incoming.open(QIODevice::ReadWrite);
+    QBufferBackedQJsonRpcSocket receiver(&incoming, this);
+    receiver.setWireFormat(static_cast<QJsonRpcSocket::WireFormat>(wireFormat));
+    QSignalSpy spyMessageReceived(&receiver, SIGNAL(messageReceived(QJsonRpcMessage)));
+    incoming.write(wire);
+
+    QTRY_COMPARE(spyMessageReceived.count(), 2);
+    QJsonRpcMessage receivedRequest = spyMessageReceived.at(0).at(0).value<QJsonRpcMessage>();
+    QJsonRpcMessage receivedNotification = spyMessageReceived.at(1).at(0).value<QJsonRpcMessage>();
+    QCOMPARE(receivedRequest.toObject(), request.toObject());
+    QCOMPARE(receivedNotification.toObject(), notification.toObject());
+
+    // copies of a broadcast frame the payload encoded for the first peer
+    const QJsonRpcSocket::WireFormat format = static_cast<QJsonRpcSocket::WireFormat>(wireFormat);
+    const QJsonRpcMessage copy = notification;
+    QCOMPARE(QJsonRpcWireFormat::encodeFrame(format, copy),
+             QJsonRpcWireFormat::encodeFrame(format, notification.toObject()));
+    QJsonRpcMessage changed = QJsonRpcMessage::fromObject(copy.toObject());
+    changed.setAttachments(QList<QByteArray>() << QByteArray("blob"));
+    QCOMPARE(QJsonRpcWireFormat::encodeFrame(format, changed),
+             QJsonRpcWireFormat::encodeFrame(format, copy));
+}
+
+void TestQJsonRpcSocket::messagePackEncoding()
+{
+    // must stay byte compatible with other MessagePack implementations
+    QJsonObject object;
+    object.insert("id", 1);
+    object.insert("jsonrpc", QLatin1String("2.0"));
+    object.insert("result", QJsonArray() << -1 << 200 << 0.5 << 1.1 << QJsonValue());
+
+    QByteArray encoded;
+    QJsonRpcWireFormat::encodeMessagePack(object, &encoded);
+    const QByteArray expected = QByteArray::fromHex(
+        "83"                        // map of 3
+        "a2" "6964" "01"            // "id": 1
+        "a7" "6a736f6e727063"       // "jsonrpc":
+        "a3" "322e30"               // "2.0"
+        "a6" "726573756c74"         // "result":
+        "95" "ff" "ccc8"            // [-1, 200,
+        "ca" "3f000000"             // 0.5 as float32,
+        "cb" "3ff199999999999a"     // 1.1 as float64,
+        "c0");                      // null]
+    QCOMPARE(encoded.toHex(), expected.toHex());
+
+    QJsonObject decoded;
+    QVERIFY(QJsonRpcWireFormat::decodeMessagePack(encoded, &decoded));
+    QCOMPARE(decoded, object);
+
+    // truncated input and trailing garbage are rejected
+    QVERIFY(!QJsonRpcWireFormat::decodeMessagePack(encoded.left(encoded.size() - 1), &decoded));
+    QVERIFY(!QJsonRpcWireFormat::decodeMessagePack(encoded + QByteArray(1, '\0'), &decoded));
+}
+
+void TestQJsonRpcSocket::compressedFrames()
+{
+    QBuffer outgoing;
+    outgoing.open(QIODevice::ReadWrite);
+    QJsonRpcSocket sender(&outgoing, this);
+    sender.setWireFormat(QJsonRpcSocket::CborWireFormat);
+    sender.setCompressionThreshold(256);
+
+    QJsonArray rows;
+    for (int i = 0; i < 100; ++i)
+        rows.append(QLatin1String("a repetitive row of report data"));
+    QJsonRpcMessage large = QJsonRpcMessage::createRequest("test.report", QJsonValue(1)).createResponse(rows);
+    QJsonRpcMessage small = QJsonRpcMessage::createNotification("test.small");
+    sender.notify(large);
+    sender.notify(small);
+
+    // only the large message crosses the threshold
+    const QByteArray wire = outgoing.data();
+    int flags = 0;
+    int payloadSize = 0;
+    QVERIFY(QJsonRpcWireFormat::readHeader(wire, &flags, &payloadSize));
+    QCOMPARE(flags, int(QJsonRpcWireFormat::CompressedFrame));
+    QVERIFY(payloadSize < 256);
+    QVERIFY(QJsonRpcWireFormat::readHeader(wire.mid(QJsonRpcWireFormat::HeaderSize + payloadSize),
+                                           &flags, &payloadSize));
+    QCOMPARE(flags, int(QJsonRpcWireFormat::NoFlags));
+
+    // receivers accept compressed frames without further configuration
+    QBuffer incoming;
+    incoming.open(QIODevice::ReadWrite);
+    QBufferBackedQJsonRpcSocket receiver(&incoming, this);
+    receiver.setWireFormat(QJsonRpcSocket::CborWireFormat);
+    QSignalSpy spyMessageReceived(&receiver, SIGNAL(messageReceived(QJsonRpcMessage)));
+    incoming.write(wire);
+
+    QTRY_COMPARE(spyMessageReceived.count(), 2);
+    QCOMPARE(spyMessageReceived.at(0).at(0).value<QJsonRpcMessage>().toObject(), large.toObject());
+    QCOMPARE(spyMessageReceived.at(1).at(0).value<QJsonRpcMessage>().toObject(), small.toObject());
+
+    // a dozen bytes claiming the largest frame are refused before anything is allocated
+    QByteArray bomb = qCompress(QByteArray("{}"));
+    qToBigEndian<quint32>(quint32(QJsonRpcWireFormat::MaximumPayloadSize), bomb.data());
+    QJsonObject object;
+    QVERIFY(!QJsonRpcWireFormat::decodeFrame(QJsonRpcSocket::CborWireFormat,
+                                             QJsonRpcWireFormat::CompressedFrame, bomb, &object));
+    quint32 claimed = 0;
+    QVERIFY(!QJsonRpcWireFormat::readUncompressedSize(bomb, &claimed));
+    QCOMPARE(claimed, quint32(QJsonRpcWireFormat::MaximumPayloadSize));
+}
+
+void TestQJsonRpcSocket::dictionaryCompressedFrames()
+{
+    if (!QJsonRpcWireFormat::hasDictionarySupport())
+        QSKIP("built without zlib");
+
+    const QByteArray dictionary = "\"test.report\",\"jsonrpc\":\"2.0\",\"result\":{\"id\":";
+    QBuffer outgoing;
+    outgoing.open(QIODevice::ReadWrite);
+    QJsonRpcSocket sender(&outgoing, this);
+    sender.setWireFormat(QJsonRpcSocket::FramedJsonWireFormat);
+    sender.setCompressionThreshold(32);
+    sender.setCompressionDictionary(dictionary);
+    QCOMPARE(sender.compressionDictionary(), dictionary);
+
+    QJsonObject row;
+    row.insert(QLatin1String("name"), QLatin1String("some row of report data"));
+    QJsonArray rows;
+    for (int i = 0; i < 20; ++i)
+        rows.append(row);
+    QJsonRpcMessage message = QJsonRpcMessage::createRequest("test.report", QJsonValue(1)).createResponse(rows);
+    sender.notify(message);
+
+    const QByteArray wire = outgoing.data();
+    int flags = 0;
+    int payloadSize = 0;
+    QVERIFY(QJsonRpcWireFormat::readHeader(wire, &flags, &payloadSize));
+    QCOMPARE(flags, int(QJsonRpcWireFormat::DictionaryFrame));
+    const QByteArray payload = wire.mid(QJsonRpcWireFormat::HeaderSize, payloadSize);
+
+    // the frame only decodes with the dictionary it was deflated with
+    QJsonObject object;
+    QVERIFY(!QJsonRpcWireFormat::decodeFrame(QJsonRpcSocket::FramedJsonWireFormat, flags, payload, &object));
+    QVERIFY(!QJsonRpcWireFormat::decodeFrame(QJsonRpcSocket::FramedJsonWireFormat, flags, payload, &object,
+                                             QByteArray("another dictionary")));
+    QVERIFY(QJsonRpcWireFormat::decodeFrame(QJsonRpcSocket::FramedJsonWireFormat, flags, payload, &object,
+                                            dictionary));
+    QCOMPARE(object, message.toObject());
+
+    QBuffer incoming;
+    incoming.open(QIODevice::ReadWrite);
+    QBufferBackedQJsonRpcSocket receiver(&incoming, this);
+    receiver.setWireFormat(QJsonRpcSocket::FramedJsonWireFormat);
+    receiver.setCompressionDictionary(dictionary);
+    QSignalSpy spyMessageReceived(&receiver, SIGNAL(messageReceived(QJsonRpcMessage)));
+    incoming.write(wire);
+
+    QTRY_COMPARE(spyMessageReceived.count(), 1);
+    QCOMPARE(spyMessageReceived.at(0).at(0).value<QJsonRpcMessage>().toObject(), message.toObject());
+
+    // a claimed size the payload can't inflate to is refused before any output is allocated
+    QByteArray inflated = payload;
+    qToBigEndian<quint32>(quint32(QJsonRpcWireFormat::MaximumPayloadSize), inflated.data());
+    QVERIFY(!QJsonRpcWireFormat::decodeFrame(QJsonRpcSocket::FramedJsonWireFormat, flags, inflated, &object,
+                                             dictionary));
+    QByteArray output;
+    QVERIFY(!QJsonRpcWireFormat::inflateWithDictionary(inflated, dictionary, &output));
+    QVERIFY(output.isEmpty());
+
+    // a stream longer than claimed is refused as well
+    QByteArray understated = payload;
+    qToBigEndian<quint32>(quint32(message.toJson(QJsonDocument::Compact).size() / 2), understated.data());
+    QVERIFY(!QJsonRpcWireFormat::inflateWithDictionary(understated, dictionary, &output));
+}
+
+void TestQJsonRpcSocket::dictionaryMismatch()
+{
+    if (!QJsonRpcWireFormat::hasDictionarySupport())
+        QSKIP("built without zlib");
+
+    const QString serverName = QLatin1String("qjsonrpc-dictionary-mismatch");
+    QLocalServer::removeServer(serverName);
+    QLocalServer server;
+    QVERIFY(server.listen(serverName));
+    QLocalSocket clientDevice;
+    clientDevice.connectToServer(serverName);
+    QVERIFY(server.waitForNewConnection(5000));
+    QLocalSocket *serverDevice = server.nextPendingConnection();
+    QVERIFY(serverDevice);
+
+    const QByteArray dictionary = "\"test.report\",\"jsonrpc\":\"2.0\",\"params\":[";
+    const QByteArray otherDictionary = "\"other.method\",\"jsonrpc\":\"2.0\",\"result\":";
+    QJsonRpcSocket sender(&clientDevice, this);
+    sender.setWireFormat(QJsonRpcSocket::FramedJsonWireFormat);
+    sender.setCompressionThreshold(32);
+    sender.setCompressionDictionary(dictionary);
+    QJsonRpcSocket receiver(serverDevice, this);
+    receiver.setWireFormat(QJsonRpcSocket::FramedJsonWireFormat);
+    receiver.setCompressionDictionary(otherDictionary);
+    QSignalSpy spySenderReceived(&sender, SIGNAL(messageReceived(QJsonRpcMessage)));
+    QSignalSpy spyReceiverReceived(&receiver, SIGNAL(messageReceived(QJsonRpcMessage)));
+
+    QJsonObject row;
+    row.insert(QLatin1String("name"), QLatin1String("some row of report data"));
+    QJsonArray rows;
+    for (int i = 0; i < 20; ++i)
+        rows.append(row);
+    sender.notify(QJsonRpcMessage::createNotification("test.report", rows));
+
+    // the receiver can't read the frame, the sender learns why instead of a silent drop
+    QTRY_COMPARE(spySenderReceived.count(), 1);
+    QCOMPARE(spyReceiverReceived.count(), 0);
+    const QJsonRpcMessage error = spySenderReceived.at(0).at(0).value<QJsonRpcMessage>();
+    QCOMPARE(error.type(), QJsonRpcMessage::Error);
+    QCOMPARE(error.errorCode(), int(QJsonRpc::ParseError));
+    const QJsonObject data = error.errorData().toObject();
+    QCOMPARE(quint32(data.value(QLatin1String("received")).toDouble()),
+             QJsonRpcWireFormat::dictionaryId(dictionary));
+    QCOMPARE(quint32(data.value(QLatin1String("expected")).toDouble()),
+             QJsonRpcWireFormat::dictionaryId(otherDictionary));
+}
+
+void TestQJsonRpcSocket::attachmentFrames()
+{
+    QByteArray image(4096, Qt::Uninitialized);
+    for (int i = 0; i < image.size(); ++i)
+        image[i] = char(i * 7);
+
+    QBuffer outgoing;
+    outgoing.open(QIODevice::ReadWrite);
+    QJsonRpcSocket sender(&outgoing, this);
+    sender.setWireFormat(QJsonRpcSocket::CborWireFormat);
+
+    QJsonObject params;
+    params.insert(QLatin1String("name"), QLatin1String("image.png"));
+    params.insert(QLatin1String("data"), QJsonRpcMessage::attachmentReference(0));
+    QJsonRpcMessage message = QJsonRpcMessage::createNotification("test.upload", params);
+    message.setAttachments(QList<QByteArray>() << image);
+    sender.notify(message);
+
+    // the raw data is sent ahead of the envelope, without base64
+    const QByteArray wire = outgoing.data();
+    int flags = 0;
+    int payloadSize = 0;
+    QVERIFY(QJsonRpcWireFormat::readHeader(wire, &flags, &payloadSize));
+    QCOMPARE(flags, int(QJsonRpcWireFormat::AttachmentFrame));
+    QCOMPARE(payloadSize, image.size());
+    QCOMPARE(wire.mid(QJsonRpcWireFormat::HeaderSize, payloadSize), image);
+
+    QBuffer incoming;
+    incoming.open(QIODevice::ReadWrite);
+    QBufferBackedQJsonRpcSocket receiver(&incoming, this);
+    receiver.setWireFormat(QJsonRpcSocket::CborWireFormat);
+    QSignalSpy spyMessageReceived(&receiver, SIGNAL(messageReceived(QJsonRpcMessage)));
+    incoming.write(wire);
+
+    QTRY_COMPARE(spyMessageReceived.count(), 1);
+    QJsonRpcMessage received = spyMessageReceived.at(0).at(0).value<QJsonRpcMessage>();
+    QCOMPARE(received.toObject(), message.toObject());
+    QCOMPARE(received.attachments().size(), 1);
+    QCOMPARE(received.attachments().first(), image);
+    QVERIFY(received.acceptsAttachments());
+}
+
 QTEST_MAIN(TestQJsonRpcSocket)
 #include "tst_qjsonrpcsocket.moc"
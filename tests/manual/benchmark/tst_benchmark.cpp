@@ -32,6 +32,7 @@
 #include "qjsonrpcsocket.h"
 #include "qjsonrpcservice.h"
 #include "qjsonrpcmessage.h"
+#include "qjsonrpcwireformat_p.h"
 
 class TestBenchmark: public QObject
 {
@@ -39,6 +40,17 @@ class TestBenchmark: public QObject
 private Q_SLOTS:
     void simple();
     void namedParameters();
+    void manyParameters_data();
+    void manyParameters();
+    void typedMethod();
+    void cachedResult();
+    void serviceRegistration();
+    void largeServiceDispatch_data();
+    void largeServiceDispatch();
+    void wireEncoding_data();
+    void wireEncoding();
+    void wireDecoding_data();
+    void wireDecoding();
 
 };
 
@@ -66,6 +78,144 @@ public Q_SLOTS:
 
         return string;
     }
+
+    int twoParams(int a, int b) { return a + b; }
+    int tenParams(int a, int b, int c, int d, int e, int f, int g, int h, int i, int j)
+    {
+        return a + b + c + d + e + f + g + h + i + j;
+    }
+    int manyParams(int a, int b, int c, int d, int e, int f, int g, int h, int i, int j, int k, int l)
+    {
+        return a + b + c + d + e + f + g + h + i + j + k + l;
+    }
+};
+
+// a service with a wide method table, 224 slots
+class LargeService : public QJsonRpcService
+{
+    Q_OBJECT
+    Q_CLASSINFO("serviceName", "large")
+public:
+    LargeService(QObject *parent = 0) : QJsonRpcService(parent)
+    {}
+
+    QJsonRpcMessage testDispatch(const QJsonRpcMessage &message) {
+        return QJsonRpcService::dispatch(message);
+    }
+
+public Q_SLOTS:
+    int method000(int v) { return v + 0; } int method001(int v) { return v + 1; }
+    int method002(int v) { return v + 2; } int method003(int v) { return v + 3; }
+    int method004(int v) { return v + 4; } int method005(int v) { return v + 5; }
+    int method006(int v) { return v + 6; } int method007(int v) { return v + 7; }
+    int method008(int v) { return v + 8; } int method009(int v) { return v + 9; }
+    int method010(int v) { return v + 10; } int method011(int v) { return v + 11; }
+    int method012(int v) { return v + 12; } int method013(int v) { return v + 13; }
+    int method014(int v) { return v + 14; } int method015(int v) { return v + 15; }
+    int method016(int v) { return v + 16; } int method017(int v) { return v + 17; }
+    int method018(int v) { return v + 18; } int method019(int v) { return v + 19; }
+    int method020(int v) { return v + 20; } int method021(int v) { return v + 21; }
+    int method022(int v) { return v + 22; } int method023(int v) { return v + 23; }
+    int method024(int v) { return v + 24; } int method025(int v) { return v + 25; }
+    int method026(int v) { return v + 26; } int method027(int v) { return v + 27; }
+    int method028(int v) { return v + 28; } int method029(int v) { return v + 29; }
+    int method030(int v) { return v + 30; } int method031(int v) { return v + 31; }
+    int method032(int v) { return v + 32; } int method033(int v) { return v + 33; }
+    int method034(int v) { return v + 34; } int method035(int v) { return v + 35; }
+    int method036(int v) { return v + 36; } int method037(int v) { return v + 37; }
+    int method038(int v) { return v + 38; } int method039(int v) { return v + 39; }
+    int method040(int v) { return v + 40; } int method041(int v) { return v + 41; }
+    int method042(int v) { return v + 42; } int method043(int v) { return v + 43; }
+    int method044(int v) { return v + 44; } int method045(int v) { return v + 45; }
+    int method046(int v) { return v + 46; } int method047(int v) { return v + 47; }
+    int method048(int v) { return v + 48; } int method049(int v) { return v + 49; }
+    int method050(int v) { return v + 50; } int method051(int v) { return v + 51; }
+    int method052(int v) { return v + 52; } int method053(int v) { return v + 53; }
+    int method054(int v) { return v + 54; } int method055(int v) { return v + 55; }
+    int method056(int v) { return v + 56; } int method057(int v) { return v + 57; }
+    int method058(int v) { return v + 58; } int method059(int v) { return v + 59; }
+    int method060(int v) { return v + 60; } int method061(int v) { return v + 61; }
+    int method062(int v) { return v + 62; } int method063(int v) { return v + 63; }
+    int method064(int v) { return v + 64; } int method065(int v) { return v + 65; }
+    int method066(int v) { return v + 66; } int method067(int v) { return v + 67; }
+    int method068(int v) { return v + 68; } int method069(int v) { return v + 69; }
+    int method070(int v) { return v + 70; } int method071(int v) { return v + 71; }
+    int method072(int v) { return v + 72; } int method073(int v) { return v + 73; }
+    int method074(int v) { return v + 74; } int method075(int v) { return v + 75; }
+    int method076(int v) { return v + 76; } int method077(int v) { return v + 77; }
+    int method078(int v) { return v + 78; } int method079(int v) { return v + 79; }
+    int method080(int v) { return v + 80; } int method081(int v) { return v + 81; }
+    int method082(int v) { return v + 82; } int method083(int v) { return v + 83; }
+    int method084(int v) { return v + 84; } int method085(int v) { return v + 85; }
+    int method086(int v) { return v + 86; } int method087(int v) { return v + 87; }
+    int method088(int v) { return v + 88; } int method089(int v) { return v + 89; }
+    int method090(int v) { return v + 90; } int method091(int v) { return v + 91; }
+    int method092(int v) { return v + 92; } int method093(int v) { return v + 93; }
+    int method094(int v) { return v + 94; } int method095(int v) { return v + 95; }
+    int method096(int v) { return v + 96; } int method097(int v) { return v + 97; }
+    int method098(int v) { return v + 98; } int method099(int v) { return v + 99; }
+    int method100(int v) { return v + 100; } int method101(int v) { return v + 101; }
+    int method102(int v) { return v + 102; } int method103(int v) { return v + 103; }
+    int method104(int v) { return v + 104; } int method105(int v) { return v + 105; }
+    int method106(int v) { return v + 106; } int method107(int v) { return v + 107; }
+    int method108(int v) { return v + 108; } int method109(int v) { return v + 109; }
+    int method110(int v) { return v + 110; } int method111(int v) { return v + 111; }
+    int method112(int v) { return v + 112; } int method113(int v) { return v + 113; }
+    int method114(int v) { return v + 114; } int method115(int v) { return v + 115; }
+    int method116(int v) { return v + 116; } int method117(int v) { return v + 117; }
+    int method118(int v) { return v + 118; } int method119(int v) { return v + 119; }
+    int method120(int v) { return v + 120; } int method121(int v) { return v + 121; }
+    int method122(int v) { return v + 122; } int method123(int v) { return v + 123; }
+    int method124(int v) { return v + 124; } int method125(int v) { return v + 125; }
+    int method126(int v) { return v + 126; } int method127(int v) { return v + 127; }
+    int method128(int v) { return v + 128; } int method129(int v) { return v + 129; }
+    int method130(int v) { return v + 130; } int method131(int v) { return v + 131; }
+    int method132(int v) { return v + 132; } int method133(int v) { return v + 133; }
+    int method134(int v) { return v + 134; } int method135(int v) { return v + 135; }
+    int method136(int v) { return v + 136; } int method137(int v) { return v + 137; }
+    int method138(int v) { return v + 138; } int method139(int v) { return v + 139; }
+    int method140(int v) { return v + 140; } int method141(int v) { return v + 141; }
+    int method142(int v) { return v + 142; } int method143(int v) { return v + 143; }
+    int method144(int v) { return v + 144; } int method145(int v) { return v + 145; }
+    int method146(int v) { return v + 146; } int method147(int v) { return v + 147; }
+    int method148(int v) { return v + 148; } int method149(int v) { return v + 149; }
+    int method150(int v) { return v + 150; } int method151(int v) { return v + 151; }
+    int method152(int v) { return v + 152; } int method153(int v) { return v + 153; }
+    int method154(int v) { return v + 154; } int method155(int v) { return v + 155; }
+    int method156(int v) { return v + 156; } int method157(int v) { return v + 157; }
+    int method158(int v) { return v + 158; } int method159(int v) { return v + 159; }
+    int method160(int v) { return v + 160; } int method161(int v) { return v + 161; }
+    int method162(int v) { return v + 162; } int method163(int v) { return v + 163; }
+    int method164(int v) { return v + 164; } int method165(int v) { return v + 165; }
+    int method166(int v) { return v + 166; } int method167(int v) { return v + 167; }
+    int method168(int v) { return v + 168; } int method169(int v) { return v + 169; }
+    int method170(int v) { return v + 170; } int method171(int v) { return v + 171; }
+    int method172(int v) { return v + 172; } int method173(int v) { return v + 173; }
+    int method174(int v) { return v + 174; } int method175(int v) { return v + 175; }
+    int method176(int v) { return v + 176; } int method177(int v) { return v + 177; }
+    int method178(int v) { return v + 178; } int method179(int v) { return v + 179; }
+    int method180(int v) { return v + 180; } int method181(int v) { return v + 181; }
+    int method182(int v) { return v + 182; } int method183(int v) { return v + 183; }
+    int method184(int v) { return v + 184; } int method185(int v) { return v + 185; }
+    int method186(int v) { return v + 186; } int method187(int v) { return v + 187; }
+    int method188(int v) { return v + 188; } int method189(int v) { return v + 189; }
+    int method190(int v) { return v + 190; } int method191(int v) { return v + 191; }
+    int method192(int v) { return v + 192; } int method193(int v) { return v + 193; }
+    int method194(int v) { return v + 194; } int method195(int v) { return v + 195; }
+    int method196(int v) { return v + 196; } int method197(int v) { return v + 197; }
+    int method198(int v) { return v + 198; } int method199(int v) { return v + 199; }
+    int method200(int v) { return v + 200; } int method201(int v) { return v + 201; }
+    int method202(int v) { return v + 202; } int method203(int v) { return v + 203; }
+    int method204(int v) { return v + 204; } int method205(int v) { return v + 205; }
+    int method206(int v) { return v + 206; } int method207(int v) { return v + 207; }
+    int method208(int v) { return v + 208; } int method209(int v) { return v + 209; }
+    int method210(int v) { return v + 210; } int method211(int v) { return v + 211; }
+    int method212(int v) { return v + 212; } int method213(int v) { return v + 213; }
+    int method214(int v) { return v + 214; } int method215(int v) { return v + 215; }
+    int method216(int v) { return v + 216; } int method217(int v) { return v + 217; }
+    int method218(int v) { return v + 218; } int method219(int v) { return v + 219; }
+    int method220(int v) { return v + 220; } int method221(int v) { return v + 221; }
+    int method222(int v) { return v + 222; } int method223(int v) { return v + 223; }
 };
 
 class TestServiceProvider : public QJsonRpcServiceProvider
@@ -107,6 +257,180 @@ void TestBenchmark::namedParameters()
     }
 }
 
+// two and ten arguments also run with invokeMethod(), which stops at ten,
+// so these rows compare directly against builds dispatching by name
+void TestBenchmark::manyParameters_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<int>("count");
+    QTest::newRow("2") << "service.twoParams" << 2;
+    QTest::newRow("10") << "service.tenParams" << 10;
+    QTest::newRow("12") << "service.manyParams" << 12;
+}
+
+void TestBenchmark::manyParameters()
+{
+    QFETCH(QString, method);
+    QFETCH(int, count);
+    TestServiceProvider provider;
+    TestService service;
+    provider.addService(&service);
+
+    QJsonArray params;
+    for (int i = 1; i <= count; ++i)
+        params.append(i);
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest(method, params);
+    QBENCHMARK {
+        QJsonRpcMessage response = service.testDispatch(request);
+        QVERIFY(response.type() != QJsonRpcMessage::Error);
+    }
+}
+
+void TestBenchmark::typedMethod()
+{
+    TestServiceProvider provider;
+    TestService service;
+    service.registerMethod("typedParam", [](const QString &string) { return string; });
+    provider.addService(&service);
+
+    QJsonRpcMessage request =
+        QJsonRpcMessage::createRequest("service.typedParam", QString("test"));
+    QBENCHMARK {
+        QJsonRpcMessage response = service.testDispatch(request);
+        QVERIFY(response.type() != QJsonRpcMessage::Error);
+    }
+}
+
+void TestBenchmark::cachedResult()
+{
+    TestServiceProvider provider;
+    TestService service;
+    service.setResultCaching("namedParams", -1);
+    provider.addService(&service);
+
+    QJsonObject obj;
+    obj["integer"] = 1;
+    obj["string"] = QLatin1String("str");
+    obj["doub"] = 1.2;
+    QJsonRpcMessage request =
+        QJsonRpcMessage::createRequest("service.namedParams", obj);
+
+    QBENCHMARK {
+        QJsonRpcMessage response = service.testDispatch(request);
+        QVERIFY(response.type() != QJsonRpcMessage::Error);
+    }
+}
+
+void TestBenchmark::serviceRegistration()
+{
+    // one instance per tenant, all of them share the method tables
+    QBENCHMARK {
+        // parentless services are owned by the provider
+        TestServiceProvider provider;
+        for (int i = 0; i < 200; ++i) {
+            TestService *service = new TestService;
+            service->setProperty("serviceName", QByteArray("tenant") + QByteArray::number(i));
+            QVERIFY(provider.addService(service));
+        }
+    }
+}
+
+void TestBenchmark::largeServiceDispatch_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::newRow("first") << "large.method000";
+    QTest::newRow("middle") << "large.method111";
+    QTest::newRow("last") << "large.method223";
+    QTest::newRow("unknown") << "large.method999";
+}
+
+void TestBenchmark::largeServiceDispatch()
+{
+    QFETCH(QString, method);
+    TestServiceProvider provider;
+    LargeService service;
+    provider.addService(&service);
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest(method, 1);
+    const bool known = !method.endsWith(QLatin1String("999"));
+    QBENCHMARK {
+        QJsonRpcMessage response = service.testDispatch(request);
+        QCOMPARE(response.type() != QJsonRpcMessage::Error, known);
+    }
+}
+
+static QJsonObject reportResponse()
+{
+    QJsonArray rows;
+    for (int i = 0; i < 1000; ++i) {
+        QJsonObject row;
+        row.insert("id", i);
+        row.insert("name", QString("item %1").arg(i));
+        row.insert("value", i * 0.25);
+        row.insert("enabled", (i % 2) == 0);
+        rows.append(row);
+    }
+
+    QJsonRpcMessage request = QJsonRpcMessage::createRequest("service.report", QJsonValue(1));
+    return request.createResponse(rows).toObject();
+}
+
+static QByteArray encodeForWire(int wireFormat, const QJsonObject &object)
+{
+    if (wireFormat == QJsonRpcSocket::JsonWireFormat)
+        return QJsonDocument(object).toJson(QJsonDocument::Compact);
+    return QJsonRpcWireFormat::encodeFrame(static_cast<QJsonRpcSocket::WireFormat>(wireFormat), object);
+}
+
+void TestBenchmark::wireEncoding_data()
+{
+    QTest::addColumn<int>("wireFormat");
+    QTest::newRow("json") << int(QJsonRpcSocket::JsonWireFormat);
+    QTest::newRow("cbor") << int(QJsonRpcSocket::CborWireFormat);
+    QTest::newRow("msgpack") << int(QJsonRpcSocket::MessagePackWireFormat);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QTest::newRow("binaryjson") << int(QJsonRpcSocket::BinaryJsonWireFormat);
+#endif
+    QTest::newRow("framedjson") << int(QJsonRpcSocket::FramedJsonWireFormat);
+}
+
+void TestBenchmark::wireEncoding()
+{
+    QFETCH(int, wireFormat);
+    const QJsonObject object = reportResponse();
+
+    QByteArray data;
+    QBENCHMARK {
+        data = encodeForWire(wireFormat, object);
+    }
+
+    QVERIFY(!data.isEmpty());
+}
+
+void TestBenchmark::wireDecoding_data()
+{
+    wireEncoding_data();
+}
+
+void TestBenchmark::wireDecoding()
+{
+    QFETCH(int, wireFormat);
+    const QJsonObject object = reportResponse();
+    const QByteArray data = encodeForWire(wireFormat, object);
+    const QByteArray payload = data.mid(QJsonRpcWireFormat::HeaderSize);
+
+    QJsonObject decoded;
+    QBENCHMARK {
+        if (wireFormat == QJsonRpcSocket::JsonWireFormat)
+            decoded = QJsonDocument::fromJson(data).object();
+        else
+            QJsonRpcWireFormat::decodePayload(static_cast<QJsonRpcSocket::WireFormat>(wireFormat),
+                                              payload, &decoded);
+    }
+
+    QCOMPARE(decoded, object);
+}
+
 QTEST_MAIN(TestBenchmark)
 #include "tst_benchmark.moc"
 